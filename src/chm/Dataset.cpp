@@ -4,8 +4,10 @@
 
 namespace chm {
 	void BruteforceIndex::queryOne(const Element& e, const size_t k, const QueryResPtr& res) {
+		this->space.getDistances(e.data, this->ids.data(), this->ids.size(), this->distances.data(), 0);
+
 		for(auto& n : this->nodes)
-			n.dist = space.getDistance(e.data, n.id);
+			n.dist = this->distances[n.id];
 
 		std::sort(this->nodes.begin(), this->nodes.end(), FarHeapCmp());
 
@@ -17,6 +19,8 @@ namespace chm {
 		const size_t dim, const size_t maxElemCount, const SIMDType simdType, const SpaceKind spaceKind
 	) : elemCount(0), space(dim, spaceKind, uint(maxElemCount), simdType) {
 
+		this->distances.reserve(maxElemCount);
+		this->ids.reserve(maxElemCount);
 		this->nodes.reserve(maxElemCount);
 	}
 
@@ -30,12 +34,34 @@ namespace chm {
 		return res;
 	}
 
+	RaggedResPtr BruteforceIndex::rangeQueryBatch(
+		const ArrayView<const float>& v, const float radius
+	) {
+		std::vector<std::vector<Node>> lists(v.getElemCount());
+
+		for(size_t i = 0; i < lists.size(); i++) {
+			this->space.getDistances(
+				v.getData(i), this->ids.data(), this->ids.size(), this->distances.data(), 0
+			);
+
+			for(const auto id : this->ids)
+				if(this->distances[id] <= radius)
+					lists[i].emplace_back(this->distances[id], id);
+
+			std::sort(lists[i].begin(), lists[i].end(), FarHeapCmp());
+		}
+
+		return std::make_shared<RaggedResults>(lists);
+	}
+
 	void BruteforceIndex::push(const ArrayView<const float>& v) {
 		const auto elemCount = v.getElemCount();
 
 		for(size_t i = 0; i < elemCount; i++) {
 			const auto id = this->elemCount + uint(i);
 			this->space.push(Element(v.getData(i), id));
+			this->distances.push_back(0.f);
+			this->ids.push_back(id);
 			this->nodes.emplace_back(0.f, id);
 		}
 	}
@@ -1,12 +1,11 @@
 #pragma once
-#include <chrono>
 #include "Index.hpp"
 
 namespace chm {
-	namespace chr = std::chrono;
-
 	class BruteforceIndex {
+		std::vector<float> distances;
 		uint elemCount;
+		std::vector<uint> ids;
 		std::vector<Node> nodes;
 		Space space;
 
@@ -19,6 +18,7 @@ namespace chm {
 		);
 		void push(const ArrayView<const float>& v);
 		QueryResPtr queryBatch(const ArrayView<const float>& v, const size_t k);
+		RaggedResPtr rangeQueryBatch(const ArrayView<const float>& v, const float radius);
 	};
 
 	class Dataset : public std::enable_shared_from_this<Dataset> {
@@ -3,17 +3,117 @@
 #include <stdexcept>
 #include "DistanceFunction.hpp"
 
+#if defined(SIMD_CAPABLE) && !defined(_MSC_VER)
+	#include <cpuid.h>
+#endif
+
 namespace chm {
+	#if defined(SIMD_CAPABLE)
+		static void cpuid(const int leaf, const int subleaf, int regs[4]) {
+			#if defined(_MSC_VER)
+				__cpuidex(regs, leaf, subleaf);
+			#else
+				unsigned int a, b, c, d;
+				__cpuid_count(leaf, subleaf, a, b, c, d);
+				regs[0] = int(a);
+				regs[1] = int(b);
+				regs[2] = int(c);
+				regs[3] = int(d);
+			#endif
+		}
+
+		// Register state the OS saves on context switches, without it the instructions fault.
+		static uint64_t getEnabledStates() {
+			#if defined(_MSC_VER)
+				return _xgetbv(0);
+			#else
+				unsigned int lo, hi;
+				__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+				return uint64_t(hi) << 32 | lo;
+			#endif
+		}
+	#endif
+
+	static CPUFeatures detectCPUFeatures() {
+		CPUFeatures res{false, false, false, false, false};
+
+		#if defined(SIMD_CAPABLE)
+			constexpr uint64_t avxStates = 0x6;
+			constexpr uint64_t avx512States = 0xE6;
+			int regs[4];
+
+			cpuid(0, 0, regs);
+			const auto maxLeaf = regs[0];
+
+			cpuid(1, 0, regs);
+			const auto ecx1 = uint32_t(regs[2]);
+			res.sse = uint32_t(regs[3]) >> 25 & 1;
+
+			const auto osxsave = ecx1 >> 27 & 1;
+			const auto states = osxsave ? getEnabledStates() : 0;
+			res.avx = (ecx1 >> 28 & 1) && (states & avxStates) == avxStates;
+
+			if(maxLeaf >= 7) {
+				cpuid(7, 0, regs);
+				const auto ebx7 = uint32_t(regs[1]);
+				const auto fma = ecx1 >> 12 & 1;
+				const auto f16c = ecx1 >> 29 & 1;
+				res.avx2 = res.avx && (ebx7 >> 5 & 1) && fma && f16c;
+				// AVX512 kernels also use DQ to split a register into halves.
+				res.avx512 = res.avx2 && (ebx7 >> 16 & 1) && (ebx7 >> 17 & 1) &&
+					(states & avx512States) == avx512States;
+
+				cpuid(7, 1, regs);
+				res.avx512bf16 = res.avx512 && (uint32_t(regs[0]) >> 5 & 1);
+			}
+		#endif
+
+		return res;
+	}
+
+	void checkSIMDType(const SIMDType type) {
+		const auto& cpu = getCPUFeatures();
+
+		switch(type) {
+			case SIMDType::AVX:
+				if(!cpu.avx)
+					throw std::runtime_error("This CPU doesn't support AVX.");
+				break;
+			case SIMDType::AVX2:
+				if(!cpu.avx2)
+					throw std::runtime_error("This CPU doesn't support AVX2 and FMA.");
+				break;
+			case SIMDType::AVX512:
+			case SIMDType::AVX512FMA:
+				if(!cpu.avx512)
+					throw std::runtime_error("This CPU doesn't support AVX512.");
+				break;
+			case SIMDType::SSE:
+				if(!cpu.sse)
+					throw std::runtime_error("This CPU doesn't support SSE.");
+				break;
+			default:
+				break;
+		}
+	}
+
 	SIMDType getBestSIMDType() {
-		#if defined(AVX512_CAPABLE)
-			return SIMDType::AVX512;
-		#elif defined(AVX_CAPABLE)
+		const auto& cpu = getCPUFeatures();
+
+		if(cpu.avx512)
+			return SIMDType::AVX512FMA;
+		if(cpu.avx2)
+			return SIMDType::AVX2;
+		if(cpu.avx)
 			return SIMDType::AVX;
-		#elif defined(SSE_CAPABLE)
+		if(cpu.sse)
 			return SIMDType::SSE;
-		#else
-			return SIMDType::NONE;
-		#endif
+		return SIMDType::NONE;
+	}
+
+	const CPUFeatures& getCPUFeatures() {
+		static const CPUFeatures features = detectCPUFeatures();
+		return features;
 	}
 
 	SIMDType getSIMDType(std::string s) {
@@ -21,8 +121,12 @@ namespace chm {
 
 		if(s == "avx")
 			return SIMDType::AVX;
+		if(s == "avx2")
+			return SIMDType::AVX2;
 		if(s == "avx512")
 			return SIMDType::AVX512;
+		if(s == "avx512fma")
+			return SIMDType::AVX512FMA;
 		if(s == "best")
 			return SIMDType::BEST;
 		if(s == "none")
@@ -36,8 +140,12 @@ namespace chm {
 		switch(s) {
 			case SIMDType::AVX:
 				return "avx";
+			case SIMDType::AVX2:
+				return "avx2";
 			case SIMDType::AVX512:
 				return "avx512";
+			case SIMDType::AVX512FMA:
+				return "avx512fma";
 			case SIMDType::BEST:
 				return SIMDTypeToStr(getBestSIMDType());
 			case SIMDType::NONE:
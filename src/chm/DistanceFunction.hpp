@@ -1,6 +1,24 @@
 #pragma once
+#include <cstdint>
+#include <cstring>
 #include <string>
 
+// Every x86-64 compiler can emit all the kernels, the running CPU decides which of them are used.
+#if defined(__x86_64__) || defined(_M_X64)
+	#ifndef SIMD_CAPABLE
+		#define SIMD_CAPABLE
+	#endif
+	#ifndef AVX_CAPABLE
+		#define AVX_CAPABLE
+	#endif
+	#ifndef AVX512_CAPABLE
+		#define AVX512_CAPABLE
+	#endif
+	#ifndef SSE_CAPABLE
+		#define SSE_CAPABLE
+	#endif
+#endif
+
 #if defined(SIMD_CAPABLE)
 	#include <immintrin.h>
 
@@ -18,6 +36,34 @@
 		#define PORTABLE_ALIGN32 __declspec(align(32))
 		#define PORTABLE_ALIGN64 __declspec(align(64))
 	#endif
+
+	// GCC and Clang only emit an instruction set inside functions that ask for it, so the rest of
+	// the library stays runnable on any x86-64 CPU. MSVC emits every intrinsic without flags.
+	#if defined(__GNUC__)
+		#define TARGET_SSE __attribute__((target("sse2")))
+		#define TARGET_AVX __attribute__((target("avx")))
+		#define TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+		#define TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx2,fma,f16c")))
+		#define TARGET_AVX512_BF16 __attribute__((target("avx512bf16,avx512f,avx512dq,avx2,fma,f16c")))
+	#else
+		#define TARGET_SSE
+		#define TARGET_AVX
+		#define TARGET_AVX2
+		#define TARGET_AVX512
+		#define TARGET_AVX512_BF16
+	#endif
+
+	#if (defined(__clang__) && __clang_major__ >= 9) || \
+		(!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 10) || \
+		(defined(_MSC_VER) && _MSC_VER >= 1920)
+		#define AVX512_BF16_CAPABLE
+	#endif
+#endif
+
+#if defined(__GNUC__)
+	#define UNROLL_LOOP _Pragma("GCC unroll 64")
+#else
+	#define UNROLL_LOOP
 #endif
 
 namespace chm {
@@ -26,15 +72,36 @@ namespace chm {
 		const size_t, const size_t, const size_t
 	);
 
+	typedef void (*BatchDistanceFunction)(
+		const float*, const float* const*, const size_t, float* const,
+		const size_t, const size_t, const size_t
+	);
+
+	typedef void (*QuantizedDistanceFunction)(
+		const float*, const float*, const uint8_t* const*, const size_t, float* const, const size_t
+	);
+
 	enum class SIMDType {
 		AVX,
+		AVX2,
 		AVX512,
+		AVX512FMA,
 		BEST,
 		NONE,
 		SSE
 	};
 
+	struct CPUFeatures {
+		bool avx;
+		bool avx2;
+		bool avx512;
+		bool avx512bf16;
+		bool sse;
+	};
+
+	void checkSIMDType(const SIMDType type);
 	SIMDType getBestSIMDType();
+	const CPUFeatures& getCPUFeatures();
 	SIMDType getSIMDType(std::string s);
 	std::string SIMDTypeToStr(const SIMDType s);
 
@@ -51,4 +118,180 @@ namespace chm {
 
 		DistanceInfo(const size_t dimLeft, const FunctionInfo funcInfo);
 	};
+
+	// Kernels instantiated for one dimension, which is then a compile-time constant.
+	struct FixedDimKernel {
+		const BatchDistanceFunction batch;
+		const size_t dim;
+		const FunctionInfo funcInfo;
+	};
+
+	template<size_t N>
+	inline const FixedDimKernel* findFixedDimKernel(const FixedDimKernel (&kernels)[N], const size_t dim) {
+		for(const auto& k : kernels)
+			if(k.dim == dim)
+				return &k;
+		return nullptr;
+	}
+
+	#if defined(AVX_CAPABLE)
+		TARGET_AVX static inline float horizontalSum(const __m256 v) {
+			float PORTABLE_ALIGN32 tmp[8];
+			_mm256_store_ps(tmp, v);
+			return tmp[0] + tmp[1] + tmp[2] + tmp[3] + tmp[4] + tmp[5] + tmp[6] + tmp[7];
+		}
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		TARGET_AVX512 static inline float horizontalSum(const __m512 v) {
+			float PORTABLE_ALIGN64 tmp[16];
+			_mm512_store_ps(tmp, v);
+			return
+				tmp[0] + tmp[1] + tmp[2] + tmp[3] +
+				tmp[4] + tmp[5] + tmp[6] + tmp[7] +
+				tmp[8] + tmp[9] + tmp[10] + tmp[11] +
+				tmp[12] + tmp[13] + tmp[14] + tmp[15];
+		}
+	#endif
+
+	#if defined(SSE_CAPABLE)
+		TARGET_SSE static inline float horizontalSum(const __m128 v) {
+			float PORTABLE_ALIGN32 tmp[4];
+			_mm_store_ps(tmp, v);
+			return tmp[0] + tmp[1] + tmp[2] + tmp[3];
+		}
+	#endif
+
+	#if defined(AVX_CAPABLE)
+		// Folds the halves together without leaving the registers.
+		TARGET_AVX static inline float reduceSum(const __m256 v) {
+			const __m128 quad = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+			const __m128 pair = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+			return _mm_cvtss_f32(_mm_add_ss(pair, _mm_movehdup_ps(pair)));
+		}
+
+		// Selects the first count lanes of a masked load, count is at most 8.
+		TARGET_AVX static inline __m256i tailMask8(const size_t count) {
+			static const int32_t lanes[16] = {-1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+			return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes + 8 - count));
+		}
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		TARGET_AVX512 static inline float reduceSum(const __m512 v) {
+			// GCC implements the cast and the f64x4 extract with an undefined source operand, which
+			// -Wall reports as uninitialized, so both halves come from the DQ extract.
+			const __m256 lo = _mm512_extractf32x8_ps(v, 0);
+			return reduceSum(_mm256_add_ps(lo, _mm512_extractf32x8_ps(v, 1)));
+		}
+	#endif
+
+	static inline float bf16ToFloat(const uint16_t h) {
+		const auto bits = uint32_t(h) << 16;
+		float res;
+		std::memcpy(&res, &bits, sizeof(res));
+		return res;
+	}
+
+	static inline uint16_t floatToBF16(const float f) {
+		uint32_t bits;
+		std::memcpy(&bits, &f, sizeof(bits));
+
+		if((bits & 0x7FFFFFFF) > 0x7F800000)
+			return uint16_t(bits >> 16 | 0x40);
+
+		// Rounds to nearest even, like the AVX512-BF16 conversions apart from their flushed denormals.
+		return uint16_t((bits + 0x7FFF + (bits >> 16 & 1)) >> 16);
+	}
+
+	static inline uint16_t floatToHalf(const float f) {
+		uint32_t bits;
+		std::memcpy(&bits, &f, sizeof(bits));
+		const auto sign = uint16_t(bits >> 16 & 0x8000);
+		bits &= 0x7FFFFFFF;
+
+		if(bits >= 0x7F800000)
+			return uint16_t(sign | 0x7C00 | (bits > 0x7F800000 ? 0x200 : 0));
+		if(bits >= 0x477FF000)
+			return uint16_t(sign | 0x7C00);
+		if(bits < 0x33000000)
+			return sign;
+
+		// Values below the smallest normal half become subnormals, both cases round to nearest even.
+		uint32_t res, rem, halfway;
+
+		if(bits < 0x38800000) {
+			const auto shift = 126 - (bits >> 23);
+			const auto mant = (bits & 0x7FFFFF) | 0x800000;
+			res = mant >> shift;
+			rem = mant & ((1u << shift) - 1);
+			halfway = 1u << (shift - 1);
+		} else {
+			res = (bits - 0x38000000) >> 13;
+			rem = bits & 0x1FFF;
+			halfway = 0x1000;
+		}
+
+		if(rem > halfway || (rem == halfway && (res & 1)))
+			res++;
+
+		return uint16_t(sign | res);
+	}
+
+	static inline float halfToFloat(const uint16_t h) {
+		const auto sign = uint32_t(h & 0x8000) << 16;
+		uint32_t exp = h >> 10 & 0x1F;
+		uint32_t mant = h & 0x3FF;
+		uint32_t bits;
+
+		if(exp == 0x1F)
+			bits = sign | 0x7F800000 | mant << 13;
+		else if(exp)
+			bits = sign | (exp + 112) << 23 | mant << 13;
+		else if(!mant)
+			bits = sign;
+		else {
+			exp = 113;
+
+			while(!(mant & 0x400)) {
+				mant <<= 1;
+				exp--;
+			}
+
+			bits = sign | exp << 23 | (mant & 0x3FF) << 13;
+		}
+
+		float res;
+		std::memcpy(&res, &bits, sizeof(res));
+		return res;
+	}
+
+	#if defined(AVX_CAPABLE)
+		TARGET_AVX2 static inline __m256 loadBF16x8AVX(const uint16_t* p) {
+			const auto words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(words), 16));
+		}
+
+		// Only used when CPUFeatures::avx2 is set, which also requires F16C.
+		TARGET_AVX2 static inline __m256 loadHalf8AVX(const uint16_t* p) {
+			return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+		}
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		// GCC warns about the undefined source of the unmasked conversions, a full zero mask emits
+		// the same instructions.
+		TARGET_AVX512 static inline __m512 loadBF16x16AVX512(const uint16_t* p) {
+			const auto all = __mmask16(0xFFFF);
+			const auto words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			return _mm512_castsi512_ps(
+				_mm512_maskz_slli_epi32(all, _mm512_maskz_cvtepu16_epi32(all, words), 16)
+			);
+		}
+
+		TARGET_AVX512 static inline __m512 loadHalf16AVX512(const uint16_t* p) {
+			const auto halves = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			return _mm512_maskz_cvtph_ps(__mmask16(0xFFFF), halves);
+		}
+	#endif
 }
@@ -1,105 +1,337 @@
 #include <cmath>
+#include <fstream>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 #include "euclideanDistance.hpp"
 #include "innerProduct.hpp"
 #include "Index.hpp"
+#include "quantizedDistance.hpp"
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
 
 namespace chm {
+	// The word must not be zero, like the compiler builtins require.
+	static size_t countTrailingZeros(const uint64_t word) {
+		#if defined(_MSC_VER)
+			unsigned long idx;
+			_BitScanForward64(&idx, word);
+			return size_t(idx);
+		#else
+			return size_t(__builtin_ctzll(word));
+		#endif
+	}
+
+	static void prefetchLine(const void* const p) {
+		#if defined(SIMD_CAPABLE)
+			_mm_prefetch(reinterpret_cast<const char*>(p), _MM_HINT_T0);
+		#else
+			(void)p;
+		#endif
+	}
+
 	Node::Node() : dist(0.f), id(0) {};
 	Node::Node(const float dist, const uint id) : dist(dist), id(id) {};
 
-	std::vector<uint>::iterator NeighborsCopy::begin() {
-		return this->n.begin();
+	uint* NeighborsBuffer::getCandidates() {
+		return this->candidates.data();
 	}
 
-	void NeighborsCopy::clear() {
-		throw std::runtime_error("NeighborsCopy object is read-only.");
+	uint* NeighborsBuffer::getData() {
+		return this->ids.data();
 	}
 
-	std::vector<uint>::iterator NeighborsCopy::end() {
-		return this->n.end();
+	float* NeighborsBuffer::getDistances() {
+		return this->distances.data();
 	}
 
-	uint NeighborsCopy::len() const {
-		return uint(this->n.size());
+	NeighborsBuffer::NeighborsBuffer(const size_t maxLen)
+		: candidates(maxLen, 0), distances(maxLen, 0.f), ids(maxLen, 0) {}
+
+	void WritableNeighbors::clear() {
+		*this->lenPtr = 0;
 	}
 
-	NeighborsCopy::NeighborsCopy(const std::vector<uint>::iterator& lenIter) {
-		auto beginIter = lenIter + 1;
-		const auto len = *lenIter;
-		this->n.reserve(len);
+	void WritableNeighbors::push(const uint id) {
+		this->lenPtr[1 + *this->lenPtr] = id;
+		(*this->lenPtr)++;
+	}
 
-		for(size_t i = 0; i < len; i++)
-			this->n.push_back(*(beginIter + i));
+	WritableNeighbors::WritableNeighbors(uint* const lenPtr) : lenPtr(lenPtr) {}
+
+	std::string lockModeToStr(const LockMode mode) {
+		switch(mode) {
+			case LockMode::MUTEX:
+				return "mutex";
+			case LockMode::SPIN:
+				return "spin";
+			case LockMode::STRIPED:
+				return "striped";
+			default:
+				throw std::runtime_error("Invalid lock mode.");
+		}
+		return "";
 	}
 
-	void NeighborsCopy::push(const uint id) {
-		throw std::runtime_error("NeighborsCopy object is read-only.");
+	Connections::Connections(
+		const uint maxElemCount, const uint mMax, const uint mMax0, const bool threadSafe,
+		const LockMode lockMode, const size_t stripeCount, InterleavedRecords* const records
+	) : header0(threadSafe && lockMode == LockMode::SPIN ? 1 : 0),
+		layer0(this->header0 + mMax0 + 1, records ? 0 : maxElemCount), lockMode(lockMode),
+		maxLen(mMax + 1), maxLen0(mMax0 + 1),
+		mutexes(1, threadSafe && lockMode == LockMode::MUTEX ? maxElemCount : 0),
+		optimisticReads(false), records(records),
+		stripes(threadSafe && lockMode == LockMode::STRIPED ? stripeCount : 0),
+		threadSafe(threadSafe), upperLayers(1, maxElemCount),
+		versions(1, threadSafe && lockMode != LockMode::SPIN ? maxElemCount : 0) {
+
+		if(threadSafe && lockMode == LockMode::STRIPED && !stripeCount)
+			throw std::runtime_error("Stripe count must be positive.");
 	}
 
-	std::vector<uint>::iterator NeighborsView::begin() {
-		return this->lenIter + 1;
+	uint* Connections::getLayer0(const uint id) {
+		return this->records ? this->records->getLinks(id) : this->layer0.getData(id);
 	}
 
-	void NeighborsView::clear() {
-		*this->lenIter = 0;
+	uint* Connections::getLenIter(const uint id, const uint lc) {
+		return lc
+			? this->upperLayers.getData(id)->data() + this->maxLen * (size_t(lc) - 1)
+			: this->getLayer0(id) + this->header0;
 	}
 
-	std::vector<uint>::iterator NeighborsView::end() {
-		return this->lenIter + 1 + *this->lenIter;
+	std::atomic<uint>& Connections::getSpinLock(const uint id) {
+		static_assert(sizeof(std::atomic<uint>) == sizeof(uint), "Spin lock must fit the header word.");
+		return *reinterpret_cast<std::atomic<uint>*>(this->getLayer0(id));
 	}
 
-	uint NeighborsView::len() const {
-		return *this->lenIter;
+	std::atomic<uint>& Connections::getVersion(const uint id) {
+		// The spin lock word is odd while locked, so it doubles as the version.
+		return this->header0 ? this->getSpinLock(id) : *this->versions.getData(id);
 	}
 
-	NeighborsView::NeighborsView(const std::vector<uint>::iterator& lenIter) : lenIter(lenIter) {};
+	void Connections::lock(const uint id) {
+		switch(this->lockMode) {
+			case LockMode::MUTEX:
+				this->mutexes.getData(id)->lock();
+				break;
+			case LockMode::SPIN: {
+				auto& spinLock = this->getSpinLock(id);
+
+				for(;;) {
+					auto v = spinLock.load(std::memory_order_relaxed);
+
+					if(!(v & 1) && spinLock.compare_exchange_weak(v, v + 1, std::memory_order_acquire))
+						break;
+
+					std::this_thread::yield();
+				}
 
-	void NeighborsView::push(const uint id) {
-		*this->end() = id;
-		(*this->lenIter)++;
+				std::atomic_thread_fence(std::memory_order_release);
+				break;
+			}
+			case LockMode::STRIPED:
+				this->stripes[id % this->stripes.size()].lock();
+				break;
+		}
 	}
 
-	std::vector<uint>::iterator Connections::getLenIter(const uint id, const uint lc) {
-		return lc
-			? this->upperLayers[id].begin() + this->maxLen * (size_t(lc) - 1)
-			: this->layer0.begin() + this->maxLen0 * id;
+	void Connections::unlock(const uint id) {
+		switch(this->lockMode) {
+			case LockMode::MUTEX:
+				this->mutexes.getData(id)->unlock();
+				break;
+			case LockMode::SPIN: {
+				auto& spinLock = this->getSpinLock(id);
+				spinLock.store(spinLock.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+				break;
+			}
+			case LockMode::STRIPED:
+				this->stripes[id % this->stripes.size()].unlock();
+				break;
+		}
 	}
 
 	Connections::Connections(
-		const uint maxElemCount, const uint mMax, const uint mMax0
-	) : maxLen(mMax + 1), maxLen0(mMax0 + 1), upperLayers(maxElemCount) {
+		const uint maxElemCount, const uint mMax, const uint mMax0,
+		InterleavedRecords* const records
+	) : Connections(maxElemCount, mMax, mMax0, false, LockMode::MUTEX, 0, records) {}
+
+	void Connections::fillHeader(IndexFileHeader& header, const uint count) {
+		header.header0 = uint32_t(this->header0);
+		header.upperLinksCount = 0;
+
+		for(uint id = 0; id < count; id++)
+			header.upperLinksCount += this->upperLayers.getData(id)->size();
+	}
+
+	uint Connections::getLevel(const uint id) const {
+		return uint(this->upperLayers.getData(id)->size() / this->maxLen);
+	}
+
+	NeighborsView Connections::getNeighbors(const uint id, const uint lc, NeighborsBuffer& buf) {
+		const auto lenIter = this->getLenIter(id, lc);
+
+		if(!this->threadSafe)
+			return NeighborsView(lenIter + 1, *lenIter);
+
+		if(this->optimisticReads) {
+			const auto maxLen = uint((lc ? this->maxLen : this->maxLen0) - 1);
+			const auto& version = this->getVersion(id);
+
+			for(;;) {
+				const auto before = version.load(std::memory_order_acquire);
 
-		this->layer0.resize(maxElemCount * this->maxLen0, 0);
-		this->upperLayers.resize(maxElemCount);
+				if(before & 1) {
+					std::this_thread::yield();
+					continue;
+				}
+
+				// A torn length can't make the copy run past the list.
+				const auto len = std::min(*lenIter, maxLen);
+				std::copy(lenIter + 1, lenIter + 1 + len, buf.getData());
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				if(version.load(std::memory_order_relaxed) == before)
+					return NeighborsView(buf.getData(), len);
+			}
+		}
+
+		this->lock(id);
+		const auto len = *lenIter;
+		std::copy(lenIter + 1, lenIter + 1 + len, buf.getData());
+		this->unlock(id);
+		return NeighborsView(buf.getData(), len);
 	}
 
-	NeighborsPtr Connections::getNeighbors(const uint id, const uint lc) {
-		return std::make_shared<NeighborsView>(this->getLenIter(id, lc));
+	WritableNeighbors Connections::getWritableNeighbors(const uint id, const uint lc) {
+		return WritableNeighbors(this->getLenIter(id, lc));
 	}
 
 	void Connections::init(const uint id, const uint level) {
 		if(level)
-			this->upperLayers[id].resize(this->maxLen * level, 0);
+			this->upperLayers.getData(id)->resize(this->maxLen * level, 0);
+	}
+
+	void Connections::load(IndexFile& file, const uint count) {
+		const auto& header = file.getHeader();
+
+		if(header.header0 != this->header0)
+			throw std::runtime_error("Index file was saved with a different lock mode.");
+		if(this->header0 && file.isMapped())
+			throw std::runtime_error("Spin locks can't live in a read-only mapping.");
+
+		if(!this->records)
+			this->layer0.load(file, count);
+
+		this->reserve(count);
+		std::vector<uint> levels(count);
+		file.read(levels.data(), levels.size() * sizeof(uint));
+		file.endSection();
+
+		uint64_t upperLinksCount = 0;
+
+		for(const auto level : levels)
+			upperLinksCount += this->maxLen * level;
+
+		if(upperLinksCount != header.upperLinksCount)
+			throw std::runtime_error("Index file is corrupted.");
+
+		// Upper layers are small, so they are always copied.
+		for(uint id = 0; id < count; id++) {
+			this->init(id, levels[id]);
+			file.read(this->upperLayers.getData(id)->data(), this->maxLen * levels[id] * sizeof(uint));
+		}
+
+		file.endSection();
+	}
+
+	void Connections::prefetch(const uint id, const uint lc) {
+		prefetchLine(this->getLenIter(id, lc));
+	}
+
+	void Connections::reserve(const size_t count) {
+		if(!this->records)
+			this->layer0.reserve(count);
+		if(this->threadSafe && this->lockMode == LockMode::MUTEX)
+			this->mutexes.reserve(count);
+		if(this->threadSafe && this->lockMode != LockMode::SPIN)
+			this->versions.reserve(count);
+
+		this->upperLayers.reserve(count);
+	}
+
+	void Connections::save(std::ostream& s, const uint count) {
+		if(!this->records)
+			this->layer0.save(s, count);
+
+		std::vector<uint> levels(count);
+		size_t upperLinksCount = 0;
+
+		for(uint id = 0; id < count; id++) {
+			levels[id] = this->getLevel(id);
+			upperLinksCount += this->upperLayers.getData(id)->size();
+		}
+
+		s.write(reinterpret_cast<const char*>(levels.data()), std::streamsize(count * sizeof(uint)));
+		IndexFile::writePadding(s, count * sizeof(uint));
+
+		for(uint id = 0; id < count; id++) {
+			const auto& links = *this->upperLayers.getData(id);
+			s.write(
+				reinterpret_cast<const char*>(links.data()),
+				std::streamsize(links.size() * sizeof(uint))
+			);
+		}
+
+		IndexFile::writePadding(s, upperLinksCount * sizeof(uint));
+	}
+
+	void ThreadSafeConnections::beginWrite(const uint id) {
+		if(this->header0)
+			return;
+
+		auto& version = *this->versions.getData(id);
+		version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	void ThreadSafeConnections::endWrite(const uint id) {
+		if(this->header0)
+			return;
+
+		auto& version = *this->versions.getData(id);
+		version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	size_t ThreadSafeConnections::getLockBytes() const {
+		return
+			(this->mutexes.getCapacity() + this->stripes.size()) * sizeof(std::mutex) +
+			this->versions.getCapacity() * sizeof(std::atomic<uint>) +
+			this->upperLayers.getCapacity() * this->header0 * sizeof(uint);
 	}
 
-	std::mutex& ThreadSafeConnections::getMutex(const uint id) {
-		return this->mutexes[id];
+	LockMode ThreadSafeConnections::getLockMode() const {
+		return this->lockMode;
 	}
 
-	NeighborsPtr ThreadSafeConnections::getNeighbors(const uint id, const uint lc) {
-		std::unique_lock<std::mutex> lock(this->getMutex(id));
-		return std::make_shared<NeighborsCopy>(this->getLenIter(id, lc));
+	size_t ThreadSafeConnections::getStripeCount() const {
+		return this->stripes.size();
 	}
 
-	NeighborsView ThreadSafeConnections::getWritableNeighbors(const uint id, const uint lc) {
-		return NeighborsView(this->getLenIter(id, lc));
+	bool ThreadSafeConnections::hasOptimisticReads() const {
+		return this->optimisticReads;
+	}
+
+	void ThreadSafeConnections::setOptimisticReads(const bool optimisticReads) {
+		this->optimisticReads = optimisticReads;
 	}
 
 	ThreadSafeConnections::ThreadSafeConnections(
-		const uint maxElemCount, const uint mMax, const uint mMax0
-	) : Connections(maxElemCount, mMax, mMax0), mutexes(maxElemCount) {}
+		const uint maxElemCount, const uint mMax, const uint mMax0,
+		const LockMode lockMode, const size_t stripeCount, InterleavedRecords* const records
+	) : Connections(maxElemCount, mMax, mMax0, true, lockMode, stripeCount, records) {}
 
 	Element Element::fail() {
 		return Element(nullptr, 0);
@@ -121,6 +353,93 @@ namespace chm {
 		return "";
 	}
 
+	// Padded vectors are compared over whole blocks of 16, their zero tails add nothing.
+	static size_t getKernelDim(const size_t dim, const bool padded) {
+		return padded ? (dim + 15) >> 4 << 4 : dim;
+	}
+
+	static QuantizedDistanceFunction getCodeDistanceFunction(
+		const SpaceKind kind, const VectorStorage storage, const SIMDType simdType
+	) {
+		const auto isEuclidean = kind == SpaceKind::EUCLIDEAN;
+
+		switch(storage) {
+			case VectorStorage::BF16:
+				return isEuclidean
+					? getEuclideanBF16BatchFunction(simdType)
+					: getInnerProductBF16BatchFunction(simdType);
+			case VectorStorage::FP16:
+				return isEuclidean
+					? getEuclideanFP16BatchFunction(simdType)
+					: getInnerProductFP16BatchFunction(simdType);
+			case VectorStorage::INT8:
+				return isEuclidean
+					? getEuclideanSQBatchFunction(simdType)
+					: getInnerProductSQBatchFunction(simdType);
+			case VectorStorage::PQ:
+				return getPQBatchFunction(simdType);
+			default:
+				return nullptr;
+		}
+	}
+
+	static size_t getCodeStride(
+		const size_t codeDim, const VectorStorage storage, const size_t subspaceCount
+	) {
+		switch(storage) {
+			case VectorStorage::BF16:
+			case VectorStorage::FP16:
+				return codeDim * sizeof(uint16_t);
+			case VectorStorage::PQ:
+				return subspaceCount;
+			default:
+				return codeDim;
+		}
+	}
+
+	void Space::encode(const float* const data, uint8_t* const code) const {
+		if(this->storage == VectorStorage::BF16 || this->storage == VectorStorage::FP16) {
+			const auto words = reinterpret_cast<uint16_t*>(code);
+			const auto convert = this->storage == VectorStorage::BF16 ? floatToBF16 : floatToHalf;
+
+			for(size_t i = 0; i < this->dim; i++)
+				words[i] = convert(data[i]);
+
+			std::fill(words + this->dim, words + this->codeDim, uint16_t(0));
+			return;
+		}
+
+		if(this->storage == VectorStorage::PQ) {
+			for(size_t m = 0; m < this->subspaceCount; m++) {
+				const auto sub = data + m * this->subspaceDim;
+				const auto codebook = this->codebooks.data() + (m << 8) * this->subspaceDim;
+				auto minDist = std::numeric_limits<float>::max();
+
+				for(size_t c = 0; c < 256; c++) {
+					const auto d = euclideanDistance(
+						codebook + c * this->subspaceDim, sub, this->subspaceDim, 0, 0, 0
+					);
+
+					if(d < minDist) {
+						minDist = d;
+						code[m] = uint8_t(c);
+					}
+				}
+			}
+			return;
+		}
+
+		for(size_t i = 0; i < this->dim; i++) {
+			const auto scale = this->sqScale[i];
+			const auto level = scale > 0.f ? std::round((data[i] - this->sqMin[i]) / scale) : 0.f;
+			code[i] = uint8_t(std::min(std::max(level, 0.f), 255.f));
+		}
+	}
+
+	const uint8_t* Space::getCode(const uint id) const {
+		return this->codes.getData(id);
+	}
+
 	float Space::getNorm(const float* const data) const {
 		float norm = 0.f;
 
@@ -130,582 +449,2269 @@ namespace chm {
 		return sqrtf(norm);
 	}
 
+	size_t Space::getAllocatedBytes() const {
+		return
+			this->elemData.getCapacity() * this->kernelDim * sizeof(float) +
+			this->codes.getCapacity() * this->getCodeBytes();
+	}
+
+	size_t Space::getCapacity() const {
+		if(this->records)
+			return this->records->getCapacity();
+		return this->hasFloats() ? this->elemData.getCapacity() : this->codes.getCapacity();
+	}
+
 	float* Space::getData(const uint id) {
-		return this->view.getData(id);
+		return this->records ? this->records->getVector(id) : this->elemData.getData(id);
 	}
 
 	const float* const Space::getData(const uint id) const {
-		return this->view.getData(id);
+		return this->records ? this->records->getVector(id) : this->elemData.getData(id);
 	}
 
 	float Space::getDistance(const float* const aData, const float* const bData) const {
 		return this->distInfo.funcInfo.f(
-			aData, bData, this->dim, this->dim4, this->dim16, this->distInfo.dimLeft
+			aData, bData, this->kernelDim, this->dim4, this->dim16, this->distInfo.dimLeft
 		);
 	}
 
-	float Space::getDistance(const float* const aData, const uint bID) const {
-		return this->getDistance(aData, this->getData(bID));
-	}
-
-	float Space::getDistance(const uint aID, const float* const bData) const {
-		return this->getDistance(this->getData(aID), bData);
-	}
+	float Space::getDistance(const float* const query, const uint id) const {
+		if(this->storage == VectorStorage::FLOAT)
+			return this->getDistance(query, this->getData(id));
 
-	float Space::getDistance(const uint aID, const uint bID) const {
-		return this->getDistance(this->getData(aID), this->getData(bID));
+		const auto code = this->getCode(id);
+		float res;
+		this->quantizedDist(query, this->sqScale.data(), &code, 1, &res, this->getCodeLen());
+		return res;
 	}
 
 	std::string Space::getDistanceName() const {
 		return this->distInfo.funcInfo.name;
 	}
 
-	void Space::normalizeData(const float* const data, float* const res) const {
-		const auto invNorm = 1.f / (this->getNorm(data) + 1e-30f);
+	void Space::getDistances(
+		const float* const query, const uint* const ids, const size_t count, float* const res,
+		const uint prefetchDistance
+	) const {
+		constexpr size_t groupLen = 4;
+		const float* nodes[groupLen];
+		const uint8_t* nodeCodes[groupLen];
 
-		for(size_t i = 0; i < this->dim; i++)
-			res[i] = data[i] * invNorm;
-	}
+		for(size_t i = 0; i < std::min(size_t(prefetchDistance), count); i++)
+			this->prefetch(ids[i]);
 
-	void Space::push(const Element& q) {
-		if(this->normalize)
-			this->normalizeData(q.data, this->getData(q.id));
-		else
-			std::copy(q.data, q.data + this->dim, this->getData(q.id));
-	}
+		for(size_t i = 0; i < count; i += groupLen) {
+			const auto len = std::min(groupLen, count - i);
 
-	Space::Space(
-		const size_t dim, const SpaceKind kind, const uint maxElemCount, const SIMDType simdType
-	) : dim16(dim >> 4 << 4), dim4(dim >> 2 << 2), distInfo(
-			kind == SpaceKind::EUCLIDEAN
-			? getEuclideanInfo(dim, this->dim4, this->dim16, simdType)
-			: getInnerProductInfo(dim, this->dim4, this->dim16, simdType)
-		), dim(dim), elemData(maxElemCount * dim, 0.f), view(this->elemData.data(), dim, maxElemCount),
-		normalize(kind == SpaceKind::ANGULAR) {}
+			for(size_t j = 0; j < len; j++) {
+				if(prefetchDistance && i + j + prefetchDistance < count)
+					this->prefetch(ids[i + j + prefetchDistance]);
 
-	bool VisitedSet::isMarked(const uint id) const {
-		return this->v[id];
-	}
+				if(this->storage == VectorStorage::FLOAT)
+					nodes[j] = this->getData(ids[i + j]);
+				else
+					nodeCodes[j] = this->getCode(ids[i + j]);
+			}
 
-	void VisitedSet::mark(const uint id) {
-		this->v[id] = true;
+			if(this->storage == VectorStorage::FLOAT)
+				this->batchDist(query, nodes, len, res + i, this->kernelDim, this->dim4, this->dim16);
+			else
+				this->quantizedDist(
+					query, this->sqScale.data(), nodeCodes, len, res + i, this->getCodeLen()
+				);
+		}
 	}
 
-	VisitedSet::VisitedSet(const uint elemCount, const uint epID) : v(elemCount, false) {
-		this->mark(epID);
+	size_t Space::getCodeBytes() const {
+		const auto isHalf = this->storage == VectorStorage::BF16 || this->storage == VectorStorage::FP16;
+		return isHalf ? this->codeDim * sizeof(uint16_t) : this->getCodeLen();
 	}
 
-	double IndexConfig::getML() const {
-		return 1.0 / std::log(double(this->mMax));
+	size_t Space::getCodeLen() const {
+		switch(this->storage) {
+			case VectorStorage::BF16:
+			case VectorStorage::FP16:
+			case VectorStorage::INT8:
+				return this->codeDim;
+			case VectorStorage::PQ:
+				return this->subspaceCount;
+			default:
+				return 0;
+		}
 	}
 
-	IndexConfig::IndexConfig(const uint efConstruction, const uint mMax, const uint maxElemCount)
-		: efConstruction(efConstruction), maxElemCount(maxElemCount), mMax(mMax), mMax0(mMax * 2) {}
+	size_t Space::getFloatCapacity() const {
+		return this->elemData.getCapacity();
+	}
 
-	QueryResults::~QueryResults() {
-		if(this->owningData) {
-			delete[] this->distances.getData(0);
-			delete[] this->ids.getData(0);
+	size_t Space::getQueryLen() const {
+		switch(this->storage) {
+			case VectorStorage::BF16:
+			case VectorStorage::FP16:
+				return this->codeDim;
+			case VectorStorage::INT8:
+				return this->codeDim + 1;
+			case VectorStorage::PQ:
+				return (this->subspaceCount << 8) + 1;
+			default:
+				return this->kernelDim;
 		}
 	}
 
-	void QueryResults::set(
-		const size_t queryIdx, const size_t neighborIdx, const float dist, const uint id
-	) {
-		this->distances.setVal(queryIdx, neighborIdx, dist);
-		this->ids.setVal(queryIdx, neighborIdx, id);
+	const float* Space::getVector(const uint id, float* const buf) const {
+		if(this->hasFloats())
+			return this->getData(id);
+
+		const auto code = this->getCode(id);
+
+		if(this->storage == VectorStorage::BF16 || this->storage == VectorStorage::FP16) {
+			const auto words = reinterpret_cast<const uint16_t*>(code);
+			const auto convert = this->storage == VectorStorage::BF16 ? bf16ToFloat : halfToFloat;
+
+			for(size_t i = 0; i < this->dim; i++)
+				buf[i] = convert(words[i]);
+
+			return buf;
+		}
+
+		if(this->storage == VectorStorage::PQ) {
+			for(size_t m = 0; m < this->subspaceCount; m++) {
+				const auto centroid = this->codebooks.data() + ((m << 8) + code[m]) * this->subspaceDim;
+				std::copy(centroid, centroid + this->subspaceDim, buf + m * this->subspaceDim);
+			}
+			return buf;
+		}
+
+		for(size_t i = 0; i < this->dim; i++)
+			buf[i] = this->sqMin[i] + this->sqScale[i] * float(code[i]);
+
+		return buf;
 	}
 
-	void QueryResults::copyIDsTo(std::vector<uint>& v) const {
-		this->ids.copyTo(v);
+	size_t Space::getVectorBytes() const {
+		return (this->hasFloats() ? this->kernelDim * sizeof(float) : 0) + this->getCodeBytes();
 	}
 
-	float QueryResults::getDistance(const size_t queryIdx, const size_t neighborIdx) {
-		return this->distances.getVal(queryIdx, neighborIdx);
+	bool Space::hasFloats() const {
+		return this->storage == VectorStorage::FLOAT || this->keepFloats;
 	}
 
-	uint QueryResults::getID(const size_t queryIdx, const size_t neighborIdx) {
-		return this->ids.getVal(queryIdx, neighborIdx);
+	bool Space::isTrained() const {
+		return this->trained;
 	}
 
-	const ArrayView<const uint> QueryResults::getIDs() const {
-		return this->ids.asConst();
+	void Space::load(IndexFile& file, const uint count) {
+		if(this->hasFloats() && !this->records)
+			this->elemData.load(file, count);
+
+		if(this->storage == VectorStorage::INT8) {
+			file.read(this->sqMin.data(), this->codeDim * sizeof(float));
+			file.read(this->sqScale.data(), this->codeDim * sizeof(float));
+		} else if(this->storage == VectorStorage::PQ)
+			file.read(this->codebooks.data(), this->codebooks.size() * sizeof(float));
+
+		if(this->storage != VectorStorage::FLOAT) {
+			file.endSection();
+			this->codes.load(file, count);
+			this->trained = true;
+		}
 	}
 
-	size_t QueryResults::getK() const {
-		return this->ids.getDim();
+	void Space::normalizeData(const float* const data, float* const res) const {
+		const auto invNorm = 1.f / (this->getNorm(data) + 1e-30f);
+
+		for(size_t i = 0; i < this->dim; i++)
+			res[i] = data[i] * invNorm;
 	}
 
-	size_t QueryResults::getQueryCount() const {
-		return this->ids.getElemCount();
+	void Space::prefetch(const uint id) const {
+		// The hardware prefetcher picks up the rest of longer vectors.
+		const auto isFloat = this->storage == VectorStorage::FLOAT;
+		const auto data = isFloat
+			? reinterpret_cast<const char*>(this->getData(id))
+			: reinterpret_cast<const char*>(this->getCode(id));
+		prefetchLine(data);
+
+		if((isFloat ? this->dim * sizeof(float) : this->getCodeBytes()) > 64)
+			prefetchLine(data + 64);
 	}
 
-	void QueryResults::push(FarHeap& h, const size_t queryIdx) {
-		for(auto neighborIdx = this->getK() - 1;; neighborIdx--) {
-			const auto node = h.extractTop();
-			this->set(queryIdx, neighborIdx, node.dist, node.id);
+	const float* Space::prepareQuery(const float* const q, float* const buf) const {
+		if(this->storage == VectorStorage::FLOAT) {
+			if(!this->padded)
+				return q;
 
-			if(!neighborIdx)
-				break;
+			std::copy(q, q + this->dim, buf);
+			std::fill(buf + this->dim, buf + this->kernelDim, 0.f);
+			return buf;
 		}
-	}
 
-	QueryResults::QueryResults(const size_t k, const size_t queryCount)
-		: distances(new float[k * queryCount], k, queryCount),
-		ids(new uint[k * queryCount], k, queryCount), owningData(true) {}
+		// Half kernels read whole blocks of 16, so the query gets the same zero padding.
+		if(this->storage == VectorStorage::BF16 || this->storage == VectorStorage::FP16) {
+			std::copy(q, q + this->dim, buf);
+			std::fill(buf + this->dim, buf + this->codeDim, 0.f);
+			return buf;
+		}
 
-	uint LevelGenerator::getNextLevel() {
-		return uint(-std::log(this->dist(this->gen)) * this->mL);
+		if(this->storage == VectorStorage::PQ) {
+			// Each entry holds the distance between a query part and one centroid of its subspace.
+			for(size_t m = 0; m < this->subspaceCount; m++) {
+				const auto sub = q + m * this->subspaceDim;
+				const auto codebook = this->codebooks.data() + (m << 8) * this->subspaceDim;
+				const auto table = buf + (m << 8);
+
+				for(size_t c = 0; c < 256; c++) {
+					const auto centroid = codebook + c * this->subspaceDim;
+					table[c] = this->kind == SpaceKind::EUCLIDEAN
+						? euclideanDistance(centroid, sub, this->subspaceDim, 0, 0, 0)
+						: -innerProductSum(centroid, sub, this->subspaceDim);
+				}
+			}
+
+			buf[this->subspaceCount << 8] = this->kind == SpaceKind::EUCLIDEAN ? 0.f : 1.f;
+			return buf;
+		}
+
+		if(this->kind == SpaceKind::EUCLIDEAN) {
+			for(size_t i = 0; i < this->dim; i++)
+				buf[i] = q[i] - this->sqMin[i];
+
+			std::fill(buf + this->dim, buf + this->codeDim + 1, 0.f);
+			return buf;
+		}
+
+		// 1 - q.x splits into a constant for the minimum and a dot product with the codes.
+		auto offset = 1.f;
+
+		for(size_t i = 0; i < this->dim; i++) {
+			buf[i] = q[i] * this->sqScale[i];
+			offset -= q[i] * this->sqMin[i];
+		}
+
+		std::fill(buf + this->dim, buf + this->codeDim, 0.f);
+		buf[this->codeDim] = offset;
+		return buf;
 	}
 
-	LevelGenerator::LevelGenerator(const double mL, const uint seed)
-		: dist(0.0, 1.0), gen(seed), mL(mL) {
+	void Space::push(const Element& q) {
+		if(this->hasFloats()) {
+			const auto data = this->getData(q.id);
+
+			if(this->normalize)
+				this->normalizeData(q.data, data);
+			else
+				std::copy(q.data, q.data + this->dim, data);
+
+			if(this->storage != VectorStorage::FLOAT)
+				this->encode(data, this->codes.getData(q.id));
+
+		} else if(this->normalize) {
+			std::vector<float> normData(this->dim);
+			this->normalizeData(q.data, normData.data());
+			this->encode(normData.data(), this->codes.getData(q.id));
+		} else
+			this->encode(q.data, this->codes.getData(q.id));
+	}
+
+	void Space::reserve(const size_t count) {
+		if(this->hasFloats() && !this->records)
+			this->elemData.reserve(count);
+		if(this->storage != VectorStorage::FLOAT)
+			this->codes.reserve(count);
+	}
+
+	void Space::save(std::ostream& s, const uint count) const {
+		if(this->hasFloats() && !this->records)
+			this->elemData.save(s, count);
+
+		if(this->storage == VectorStorage::INT8) {
+			const auto paramBytes = this->codeDim * sizeof(float);
+			s.write(reinterpret_cast<const char*>(this->sqMin.data()), std::streamsize(paramBytes));
+			s.write(reinterpret_cast<const char*>(this->sqScale.data()), std::streamsize(paramBytes));
+			IndexFile::writePadding(s, 2 * paramBytes);
+		} else if(this->storage == VectorStorage::PQ) {
+			const auto paramBytes = this->codebooks.size() * sizeof(float);
+			s.write(reinterpret_cast<const char*>(this->codebooks.data()), std::streamsize(paramBytes));
+			IndexFile::writePadding(s, paramBytes);
+		}
+
+		if(this->storage != VectorStorage::FLOAT)
+			this->codes.save(s, count);
 	}
 
-	NearHeap AbstractIndex::getNearHeap(NeighborsPtr n, const float* const q) {
-		NearHeap res;
+	Space::Space(
+		const size_t dim, const SpaceKind kind, const uint maxElemCount, const SIMDType simdType
+	) : Space(dim, kind, maxElemCount, simdType, nullptr) {}
+
+	Space::Space(
+		const size_t dim, const SpaceKind kind, const uint maxElemCount, const SIMDType simdType,
+		const InterleavedRecords* const records, const VectorStorage storage, const bool keepFloats,
+		const size_t subspaceCount, const bool padded
+	) : batchDist(
+			kind == SpaceKind::EUCLIDEAN
+			? getEuclideanBatchFunction(getKernelDim(dim, padded), simdType)
+			: getInnerProductBatchFunction(getKernelDim(dim, padded), simdType)
+		), codebooks(storage == VectorStorage::PQ ? dim << 8 : 0, 0.f), codeDim((dim + 15) >> 4 << 4),
+		codes(
+			getCodeStride(this->codeDim, storage, subspaceCount),
+			storage == VectorStorage::FLOAT ? 0 : maxElemCount
+		),
+		dim16(getKernelDim(dim, padded) >> 4 << 4), dim4(getKernelDim(dim, padded) >> 2 << 2),
+		distInfo(
+			kind == SpaceKind::EUCLIDEAN
+			? getEuclideanInfo(getKernelDim(dim, padded), this->dim4, this->dim16, simdType)
+			: getInnerProductInfo(getKernelDim(dim, padded), this->dim4, this->dim16, simdType)
+		), elemData(
+			getKernelDim(dim, padded),
+			records || (storage != VectorStorage::FLOAT && !keepFloats) ? 0 : maxElemCount
+		), keepFloats(keepFloats), kernelDim(getKernelDim(dim, padded)),
+		quantizedDist(getCodeDistanceFunction(kind, storage, simdType)),
+		records(records), sqMin(this->codeDim, 0.f), sqScale(this->codeDim, 0.f),
+		subspaceCount(subspaceCount), subspaceDim(subspaceCount ? dim / subspaceCount : 0),
+		trained(storage != VectorStorage::INT8 && storage != VectorStorage::PQ), dim(dim), kind(kind),
+		normalize(kind == SpaceKind::ANGULAR), padded(padded), storage(storage) {
+
+		if(storage == VectorStorage::PQ && (!subspaceCount || dim % subspaceCount))
+			throw std::runtime_error("Subspace count must divide the dimension.");
+		if(padded && (records || storage != VectorStorage::FLOAT))
+			throw std::runtime_error("Padded vectors need float storage and the split layout.");
+	}
+
+	void Space::trainCodebooks(const std::vector<float>& samples, const size_t sampleCount) {
+		constexpr size_t centroidCount = 256;
+		constexpr size_t iterations = 10;
+		const auto subDim = this->subspaceDim;
+		std::vector<uint8_t> assignment(sampleCount);
+		std::vector<size_t> counts(centroidCount);
+		std::default_random_engine gen(104);
+		std::uniform_int_distribution<size_t> pick(0, sampleCount - 1);
+		std::vector<float> sub(sampleCount * subDim);
+
+		// Plain k-means per subspace, centroids start at random samples.
+		for(size_t m = 0; m < this->subspaceCount; m++) {
+			const auto codebook = this->codebooks.data() + m * centroidCount * subDim;
+
+			for(size_t i = 0; i < sampleCount; i++) {
+				const auto src = samples.data() + i * this->dim + m * subDim;
+				std::copy(src, src + subDim, sub.data() + i * subDim);
+			}
 
-		for(const auto& id : *n)
-			res.push(Node(this->space.getDistance(id, q), id));
+			for(size_t c = 0; c < centroidCount; c++) {
+				const auto src = sub.data() + pick(gen) * subDim;
+				std::copy(src, src + subDim, codebook + c * subDim);
+			}
 
-		return res;
+			for(size_t it = 0; it < iterations; it++) {
+				for(size_t i = 0; i < sampleCount; i++) {
+					auto minDist = std::numeric_limits<float>::max();
+
+					for(size_t c = 0; c < centroidCount; c++) {
+						const auto d = euclideanDistance(
+							codebook + c * subDim, sub.data() + i * subDim, subDim, 0, 0, 0
+						);
+
+						if(d < minDist) {
+							minDist = d;
+							assignment[i] = uint8_t(c);
+						}
+					}
+				}
+
+				std::fill(codebook, codebook + centroidCount * subDim, 0.f);
+				std::fill(counts.begin(), counts.end(), size_t(0));
+
+				for(size_t i = 0; i < sampleCount; i++) {
+					const auto centroid = codebook + assignment[i] * subDim;
+					const auto src = sub.data() + i * subDim;
+					counts[assignment[i]]++;
+
+					for(size_t d = 0; d < subDim; d++)
+						centroid[d] += src[d];
+				}
+
+				// An empty cluster restarts at a random sample.
+				for(size_t c = 0; c < centroidCount; c++) {
+					const auto centroid = codebook + c * subDim;
+
+					if(counts[c]) {
+						for(size_t d = 0; d < subDim; d++)
+							centroid[d] /= float(counts[c]);
+					} else {
+						const auto src = sub.data() + pick(gen) * subDim;
+						std::copy(src, src + subDim, centroid);
+					}
+				}
+			}
+		}
 	}
 
-	Node AbstractIndex::processLowerLayer(const Node& ep, const uint lc, const Element& q) {
-		auto W = this->searchLowerLayer(this->cfg.efConstruction, ep, lc, q.data, false);
-		const auto R = this->selectNeighbors(this->cfg.mMax, q.data, NearHeap(W));
-		this->writeNeighbors(q.id, lc, R);
-		const auto mLayer = lc ? this->cfg.mMax : this->cfg.mMax0;
+	void Space::train(const ArrayView<const float>& v) {
+		if(this->storage == VectorStorage::PQ) {
+			// A strided sample bounds the k-means cost on large batches.
+			constexpr size_t maxSampleCount = 256 * 64;
+			const auto step = std::max(v.getElemCount() / maxSampleCount, size_t(1));
+			const auto sampleCount = (v.getElemCount() + step - 1) / step;
+			std::vector<float> samples(sampleCount * this->dim);
 
-		for(const auto& e : R) {
-			const auto eData = this->space.getData(e.id);
-			auto N = this->getConn()->getNeighbors(e.id, lc);
-			auto nHeap = this->getNearHeap(N, eData);
-			nHeap.push(Node(this->space.getDistance(eData, q.data), q.id));
-
-			if(nHeap.len() > mLayer) {
-				const auto nRes = this->selectNeighbors(mLayer, eData, nHeap);
-				this->writeNeighbors(e.id, lc, N, nRes);
-			} else
-				this->writeNeighbors(e.id, lc, N, nHeap);
+			for(size_t i = 0; i < sampleCount; i++) {
+				const auto data = v.getData(i * step);
+				const auto dst = samples.data() + i * this->dim;
+
+				if(this->normalize)
+					this->normalizeData(data, dst);
+				else
+					std::copy(data, data + this->dim, dst);
+			}
+
+			this->trainCodebooks(samples, sampleCount);
+			this->trained = true;
+			return;
+		}
+
+		// Each dimension spreads its observed range over the 256 levels of a byte.
+		std::vector<float> maxVal(this->dim, std::numeric_limits<float>::lowest());
+		std::vector<float> normData(this->dim);
+		std::fill(this->sqMin.begin(), this->sqMin.begin() + this->dim, std::numeric_limits<float>::max());
+
+		for(size_t i = 0; i < v.getElemCount(); i++) {
+			auto data = v.getData(i);
+
+			if(this->normalize) {
+				this->normalizeData(data, normData.data());
+				data = normData.data();
+			}
+
+			for(size_t d = 0; d < this->dim; d++) {
+				this->sqMin[d] = std::min(this->sqMin[d], data[d]);
+				maxVal[d] = std::max(maxVal[d], data[d]);
+			}
 		}
 
-		return *std::min_element(R.cbegin(), R.cend(), FarHeapCmp());
+		for(size_t d = 0; d < this->dim; d++)
+			this->sqScale[d] = (maxVal[d] - this->sqMin[d]) / 255.f;
+
+		this->trained = true;
 	}
 
-	FarHeap AbstractIndex::searchLowerLayer(
-		const uint ef, const Node& ep, const uint lc, const float* const q, const bool s
-	) {
-		NearHeap C(ep);
-		auto V = this->getVisitedSet(ep);
-		FarHeap W(ep);
+	std::string vectorStorageToStr(const VectorStorage storage) {
+		switch(storage) {
+			case VectorStorage::FLOAT:
+				return "float";
+			case VectorStorage::INT8:
+				return "int8";
+			case VectorStorage::PQ:
+				return "pq";
+			case VectorStorage::FP16:
+				return "fp16";
+			case VectorStorage::BF16:
+				return "bf16";
+			default:
+				throw std::runtime_error("Invalid vector storage.");
+		}
+		return "";
+	}
 
-		while(C.len()) {
-			auto c = C.extractTop();
-			auto f = W.top();
+	bool VisitedSet::isMarked(const uint id) const {
+		// Nodes added after the set was sized are never marked yet.
+		return id < this->marks.size() && this->marks[id] == this->epoch;
+	}
 
-			if(
-				(s || W.len() == ef) &&
-				this->space.getDistance(c.id, q) > this->space.getDistance(f.id, q)
-			)
-				break;
+	void VisitedSet::mark(const uint id) {
+		if(id >= this->marks.size())
+			this->marks.resize(std::max(size_t(id) + 1, this->marks.size() * 2), 0);
 
-			const auto N = this->getConn()->getNeighbors(c.id, lc);
+		this->marks[id] = this->epoch;
+	}
 
-			for(const auto& eID : *N)
-				if(!V->isMarked(eID)) {
-					V->mark(eID);
-					f = W.top();
-					Node e(this->space.getDistance(eID, q), eID);
+	void VisitedSet::prepare(const uint epID) {
+		this->epoch++;
 
-					if(W.len() < ef || f.dist > e.dist) {
-						C.push(e);
-						W.push(e);
+		if(!this->epoch) {
+			std::fill(this->marks.begin(), this->marks.end(), uint16_t(0));
+			this->epoch = 1;
+		}
 
-						if(W.len() > ef)
-							W.pop();
-					}
+		this->mark(epID);
+	}
+
+	VisitedSet::VisitedSet(const uint elemCount) : epoch(0), marks(elemCount, 0) {}
+
+	void IDFilter::allow(const uint id) {
+		if(size_t(id) >= this->words.size() * 64)
+			throw std::runtime_error("Allowed ID exceeds the size of the filter.");
+
+		auto& word = this->words[id / 64];
+		const auto bit = uint64_t(1) << (id % 64);
+
+		if(!(word & bit)) {
+			word |= bit;
+			this->allowedCount++;
+		}
+	}
+
+	uint IDFilter::findNext(const uint id) const {
+		auto wordIdx = size_t(id / 64);
+
+		if(wordIdx >= this->words.size())
+			return std::numeric_limits<uint>::max();
+
+		// Bits below id are cleared, so the lowest set bit left is the answer.
+		auto word = this->words[wordIdx] & (~uint64_t(0) << (id % 64));
+
+		while(!word) {
+			if(++wordIdx == this->words.size())
+				return std::numeric_limits<uint>::max();
+
+			word = this->words[wordIdx];
+		}
+
+		return uint(wordIdx * 64 + countTrailingZeros(word));
+	}
+
+	size_t IDFilter::getAllowedCount() const {
+		return this->allowedCount;
+	}
+
+	IDFilter::IDFilter(const size_t elemCount) : allowedCount(0), words((elemCount + 63) / 64, 0) {}
+
+	IDFilter::IDFilter(const size_t elemCount, const std::function<bool(const uint)>& isAllowed)
+		: IDFilter(elemCount) {
+
+		for(size_t id = 0; id < elemCount; id++)
+			if(isAllowed(uint(id)))
+				this->allow(uint(id));
+	}
+
+	bool IDFilter::isAllowed(const uint id) const {
+		// IDs past the end of the filter belong to nodes added after it was built.
+		const auto wordIdx = size_t(id / 64);
+		return wordIdx < this->words.size() && (this->words[wordIdx] >> (id % 64) & 1);
+	}
+
+	std::string filterModeToStr(const FilterMode mode) {
+		switch(mode) {
+			case FilterMode::AUTO:
+				return "auto";
+			case FilterMode::BRUTEFORCE:
+				return "bruteforce";
+			case FilterMode::GRAPH:
+				return "graph";
+			default:
+				throw std::runtime_error("Unknown filter mode.");
+		}
+
+		return "";
+	}
+
+	double IndexConfig::getML() const {
+		return this->mL;
+	}
+
+	IndexConfig::IndexConfig(
+		const uint efConstruction, const uint mMax, const uint maxElemCount, const StorageLayout layout,
+		const double mL, const VectorStorage storage, const bool rerank, const uint pqSubspaces,
+		const bool padded
+	) : efConstruction(efConstruction), layout(layout), maxElemCount(maxElemCount),
+		mL(mL > 0.0 ? mL : 1.0 / std::log(double(mMax))), mMax(mMax), mMax0(mMax * 2), padded(padded),
+		pqSubspaces(pqSubspaces), rerank(rerank), storage(storage) {}
+
+	ContextPtr ContextPool::acquire() {
+		std::unique_lock<std::mutex> lock(this->m);
+
+		if(this->contexts.empty())
+			return std::make_shared<SearchContext>(this->cfg, this->space);
+
+		auto res = this->contexts.back();
+		this->contexts.pop_back();
+		return res;
+	}
+
+	AlignedFloats::AlignedFloats(const size_t len)
+		: lines((len * sizeof(float) + sizeof(CacheLine) - 1) / sizeof(CacheLine)) {}
+
+	float* AlignedFloats::data() {
+		return reinterpret_cast<float*>(this->lines.data());
+	}
+
+	void ContextPool::release(const ContextPtr& ctx) {
+		std::unique_lock<std::mutex> lock(this->m);
+		this->contexts.push_back(ctx);
+	}
+
+	ContextPool::ContextPool(const IndexConfig& cfg, const Space& space) : cfg(cfg), space(space) {}
+
+	SearchContext::SearchContext(const IndexConfig& cfg, const Space& space)
+		: buf(cfg.mMax0), decoded(space.dim), neighbors(cfg.mMax0 + 1), neighborDecoded(space.dim),
+		nodeQuery(space.getQueryLen()), normalized(space.dim), query(space.getQueryLen()),
+		reranked(cfg.efConstruction),
+		results(cfg.efConstruction), visited(cfg.maxElemCount) {}
+
+	std::string storageLayoutToStr(const StorageLayout layout) {
+		switch(layout) {
+			case StorageLayout::INTERLEAVED:
+				return "interleaved";
+			case StorageLayout::SPLIT:
+				return "split";
+			default:
+				throw std::runtime_error("Invalid storage layout.");
+		}
+		return "";
+	}
+
+	size_t InterleavedRecords::getCapacity() const {
+		return this->lines.getCapacity();
+	}
+
+	// Vector first, then the spin lock word, length and layer 0 links, padded to cache lines.
+	InterleavedRecords::InterleavedRecords(const IndexConfig& cfg, const size_t dim)
+		: enabled(cfg.layout == StorageLayout::INTERLEAVED), lines(
+			(dim * sizeof(float) + (size_t(cfg.mMax0) + 2) * sizeof(uint) + sizeof(CacheLine) - 1) /
+			sizeof(CacheLine), this->enabled ? cfg.maxElemCount : 0
+		), linksOffset(dim * sizeof(float)) {}
+
+	bool InterleavedRecords::isEnabled() const {
+		return this->enabled;
+	}
+
+	void InterleavedRecords::load(IndexFile& file, const uint count) {
+		if(this->enabled)
+			this->lines.load(file, count);
+	}
+
+	void InterleavedRecords::reserve(const size_t count) {
+		if(this->enabled)
+			this->lines.reserve(count);
+	}
+
+	void InterleavedRecords::save(std::ostream& s, const uint count) const {
+		if(this->enabled)
+			this->lines.save(s, count);
+	}
+
+	QueryResults::~QueryResults() {
+		if(this->owningData) {
+			delete[] this->distances.getData(0);
+			delete[] this->ids.getData(0);
+		}
+	}
+
+	void QueryResults::set(
+		const size_t queryIdx, const size_t neighborIdx, const float dist, const uint id
+	) {
+		this->distances.setVal(queryIdx, neighborIdx, dist);
+		this->ids.setVal(queryIdx, neighborIdx, id);
+	}
+
+	void QueryResults::copyIDsTo(std::vector<uint>& v) const {
+		this->ids.copyTo(v);
+	}
+
+	float QueryResults::getDistance(const size_t queryIdx, const size_t neighborIdx) {
+		return this->distances.getVal(queryIdx, neighborIdx);
+	}
+
+	uint QueryResults::getID(const size_t queryIdx, const size_t neighborIdx) {
+		return this->ids.getVal(queryIdx, neighborIdx);
+	}
+
+	const ArrayView<const uint> QueryResults::getIDs() const {
+		return this->ids.asConst();
+	}
+
+	size_t QueryResults::getK() const {
+		return this->ids.getDim();
+	}
+
+	size_t QueryResults::getQueryCount() const {
+		return this->ids.getElemCount();
+	}
+
+	void QueryResults::push(const SearchBuffer& W, const size_t queryIdx) {
+		const auto found = std::min(this->getK(), size_t(W.len()));
+
+		for(size_t neighborIdx = 0; neighborIdx < found; neighborIdx++) {
+			const auto node = W.get(uint(neighborIdx));
+			this->set(queryIdx, neighborIdx, node.dist, node.id);
+		}
+
+		for(size_t neighborIdx = found; neighborIdx < this->getK(); neighborIdx++)
+			this->set(
+				queryIdx, neighborIdx, std::numeric_limits<float>::infinity(), QueryResults::missingID
+			);
+	}
+
+	QueryResults::QueryResults(const size_t k, const size_t queryCount)
+		: distances(new float[k * queryCount], k, queryCount),
+		ids(new uint[k * queryCount], k, queryCount), owningData(true) {}
+
+	size_t RaggedResults::getCount(const size_t queryIdx) const {
+		return this->offsets[queryIdx + 1] - this->offsets[queryIdx];
+	}
+
+	float RaggedResults::getDistance(const size_t queryIdx, const size_t neighborIdx) const {
+		return this->distances[this->offsets[queryIdx] + neighborIdx];
+	}
+
+	uint RaggedResults::getID(const size_t queryIdx, const size_t neighborIdx) const {
+		return this->ids[this->offsets[queryIdx] + neighborIdx];
+	}
+
+	const std::vector<uint>& RaggedResults::getIDs() const {
+		return this->ids;
+	}
+
+	const std::vector<size_t>& RaggedResults::getOffsets() const {
+		return this->offsets;
+	}
+
+	size_t RaggedResults::getQueryCount() const {
+		return this->offsets.size() - 1;
+	}
+
+	size_t RaggedResults::getTotalCount() const {
+		return this->ids.size();
+	}
+
+	void RaggedResults::push(const SearchBuffer& W, const size_t queryIdx) {
+		const auto first = this->offsets[queryIdx];
+		const auto count = std::min(this->offsets[queryIdx + 1] - first, size_t(W.len()));
+
+		for(size_t i = 0; i < count; i++) {
+			const auto node = W.get(uint(i));
+			this->distances[first + i] = node.dist;
+			this->ids[first + i] = node.id;
+		}
+
+		this->counts[queryIdx] = uint(count);
+	}
+
+	RaggedResults::RaggedResults(const std::vector<std::vector<Node>>& lists) {
+		this->counts.reserve(lists.size());
+		this->offsets.reserve(lists.size() + 1);
+		this->offsets.push_back(0);
+
+		for(const auto& l : lists) {
+			this->counts.push_back(uint(l.size()));
+			this->offsets.push_back(this->offsets.back() + l.size());
+		}
+
+		this->distances.reserve(this->offsets.back());
+		this->ids.reserve(this->offsets.back());
+
+		for(const auto& l : lists)
+			for(const auto& n : l) {
+				this->distances.push_back(n.dist);
+				this->ids.push_back(n.id);
+			}
+	}
+
+	RaggedResults::RaggedResults(const std::vector<uint>& capacities)
+		: counts(capacities.size(), 0) {
+
+		this->offsets.reserve(capacities.size() + 1);
+		this->offsets.push_back(0);
+
+		for(const auto c : capacities)
+			this->offsets.push_back(this->offsets.back() + c);
+
+		this->distances.resize(this->offsets.back());
+		this->ids.resize(this->offsets.back());
+	}
+
+	// Closes the gaps left by queries that found fewer neighbors than they asked for.
+	void RaggedResults::trim() {
+		size_t pos = 0;
+
+		for(size_t queryIdx = 0; queryIdx < this->counts.size(); queryIdx++) {
+			const auto first = this->offsets[queryIdx];
+			const auto count = this->counts[queryIdx];
+
+			if(pos != first) {
+				std::copy_n(this->distances.begin() + first, count, this->distances.begin() + pos);
+				std::copy_n(this->ids.begin() + first, count, this->ids.begin() + pos);
+				this->offsets[queryIdx] = pos;
+			}
+
+			pos += count;
+		}
+
+		this->offsets.back() = pos;
+		this->distances.resize(pos);
+		this->ids.resize(pos);
+	}
+
+	bool SearchBudget::isLimited() const {
+		return this->maxDistances || this->maxHops || this->patience || this->timeLimit.count();
+	}
+
+	SearchBudget::SearchBudget(
+		const uint maxDistances, const uint maxHops, const chr::nanoseconds timeLimit,
+		const uint patience
+	) : maxDistances(maxDistances), maxHops(maxHops), patience(patience), timeLimit(timeLimit) {}
+
+	BudgetTracker::BudgetTracker(const SearchBudget& budget, const uint k)
+		: budget(budget), distances(0), hops(0), k(k),
+		kthDist(std::numeric_limits<float>::max()), stableHops(0) {
+
+		if(budget.timeLimit.count())
+			this->deadline = chr::steady_clock::now() + budget.timeLimit;
+	}
+
+	// Counts one expansion of a layer 0 node and returns false once the search should stop.
+	bool BudgetTracker::expand(const uint distanceCount, const SearchBuffer& W) {
+		this->distances += distanceCount;
+		this->hops++;
+
+		if(this->budget.maxDistances && this->distances >= this->budget.maxDistances)
+			return false;
+		if(this->budget.maxHops && this->hops >= this->budget.maxHops)
+			return false;
+
+		// Any node entering the top k moves its farthest member closer. With k == 0 there is nothing
+		// to watch, so patience never stops the search.
+		if(this->budget.patience && this->k && W.len() >= this->k) {
+			const auto kthDist = W.get(this->k - 1).dist;
+
+			if(kthDist < this->kthDist) {
+				this->kthDist = kthDist;
+				this->stableHops = 0;
+			} else if(++this->stableHops >= this->budget.patience)
+				return false;
+		}
+
+		return !this->budget.timeLimit.count() || chr::steady_clock::now() < this->deadline;
+	}
+
+	uint LevelGenerator::getNextLevel() {
+		return uint(-std::log(this->dist(this->gen)) * this->mL);
+	}
+
+	LevelGenerator::LevelGenerator(const double mL, const uint seed)
+		: dist(0.0, 1.0), gen(seed), mL(mL) {
+	}
+
+	std::vector<uint> AbstractIndex::claimDeletedSlots(const size_t count) {
+		std::vector<uint> ids;
+		std::unique_lock<std::mutex> lock(this->freeSlotsMutex);
+
+		// Searches would enter a refilled entry slot through its new vector but old links, so the
+		// entry stays in front of the list until a higher node replaces it.
+		const auto entryID = this->getEntryID();
+		const auto kept = size_t(std::partition(
+			this->freeSlots.begin(), this->freeSlots.end(),
+			[entryID](const uint id) { return id == entryID; }
+		) - this->freeSlots.begin());
+
+		// A slot unmarked after it was freed fails the exchange and only leaves the list.
+		while(ids.size() < count && this->freeSlots.size() > kept) {
+			const auto id = this->freeSlots.back();
+			auto expected = Tombstone::DELETED;
+			this->freeSlots.pop_back();
+
+			if(this->tombstones.getData(id)->compare_exchange_strong(expected, Tombstone::REUSED))
+				ids.push_back(id);
+		}
+
+		return ids;
+	}
+
+	void AbstractIndex::getNearest(
+		const NeighborsView& N, const float* const query, SearchContext& ctx
+	) {
+		const auto distances = ctx.buf.getDistances();
+		this->space.getDistances(query, N.begin(), N.len(), distances, this->prefetchDistance);
+		ctx.neighbors.reset(this->cfg.mMax0 + 1);
+
+		for(uint i = 0; i < N.len(); i++)
+			ctx.neighbors.push(distances[i], N.begin()[i]);
+	}
+
+	// The vector of q is already stored, the element is only linked into the graph on layers lMin
+	// to l. Returns the level of the entry the search started from.
+	uint AbstractIndex::linkElement(
+		const Element& q, const uint l, SearchContext& ctx, const uint lMin
+	) {
+		// Angular neighbors are stored normalized, so the new vector is compared the same way.
+		auto data = q.data;
+
+		if(this->space.normalize) {
+			this->space.normalizeData(q.data, ctx.normalized.data());
+			data = ctx.normalized.data();
+		}
+
+		const auto query = this->space.prepareQuery(data, ctx.query.data());
+		const auto entry = this->entry.load(std::memory_order_acquire);
+		const auto entryID = uint(entry);
+		Node ep(this->space.getDistance(query, entryID), entryID);
+		const auto L = uint(entry >> 32);
+		auto lc = L;
+
+		while(lc > l) {
+			ep = this->searchUpperLayer(ep, lc, query, ctx.buf);
+			lc--;
+		}
+
+		lc = std::min(L, l);
+
+		for(;;) {
+			ep = this->processLowerLayer(ep, lc, q, query, ctx);
+
+			if(lc == lMin)
+				break;
+
+			lc--;
+		}
+
+		return L;
+	}
+
+	std::shared_lock<std::shared_mutex> AbstractIndex::lockVectors() {
+		// Without deleted elements no slot can be reused, so searches leave the mutex alone. A search
+		// that started before the first deletion stays unlocked while a reuse round may replace a
+		// vector it reads.
+		std::shared_lock<std::shared_mutex> lock(this->vectorsMutex, std::defer_lock);
+
+		if(this->deletedCount.load(std::memory_order_acquire))
+			lock.lock();
+
+		return lock;
+	}
+
+	Node AbstractIndex::processLowerLayer(
+		const Node& ep, const uint lc, const Element& q, const float* const query,
+		SearchContext& ctx
+	) {
+		this->searchLowerLayer(this->cfg.efConstruction, ep, lc, query, ctx);
+
+		// A reused slot is still linked, so the search can reach the node itself.
+		ctx.results.remove(q.id);
+
+		const auto R = this->selectNeighbors(this->cfg.mMax, ctx.results, ctx);
+		this->writeNeighbors(q.id, lc, R);
+		const auto mLayer = lc ? this->cfg.mMax : this->cfg.mMax0;
+		const auto conn = this->getConn();
+
+		for(const auto& e : R) {
+			// Quantized nodes are compared with the same codes their neighbors were, q included.
+			const auto eQuery = this->space.prepareQuery(
+				this->space.getVector(e.id, ctx.decoded.data()), ctx.nodeQuery.data()
+			);
+			const auto N = conn->getNeighbors(e.id, lc, ctx.buf);
+			this->getNearest(N, eQuery, ctx);
+
+			if(std::find(N.begin(), N.end(), q.id) == N.end())
+				ctx.neighbors.push(this->space.getDistance(eQuery, q.id), q.id);
+
+			if(ctx.neighbors.len() > mLayer) {
+				const auto nRes = this->selectNeighbors(mLayer, ctx.neighbors, ctx);
+				this->writeNeighbors(e.id, lc, nRes);
+			} else
+				this->writeNeighbors(e.id, lc, ctx.neighbors);
+		}
+
+		return R.empty() ? ep : R.front();
+	}
+
+	void AbstractIndex::searchLowerLayer(
+		const uint ef, const Node& ep, const uint lc, const float* const q, SearchContext& ctx,
+		BudgetTracker* const tracker
+	) {
+		auto& W = ctx.results;
+		W.reset(ef);
+		W.push(ep.dist, ep.id);
+		ctx.visited.prepare(ep.id);
+		const auto conn = this->getConn();
+		const auto skipReused = this->reusing.load(std::memory_order_relaxed);
+
+		// W is sorted, so its closest unexpanded node is the next candidate and the search ends
+		// once every node within the ef closest has been expanded.
+		while(W.hasNext()) {
+			const auto c = W.extractNext();
+			const auto N = conn->getNeighbors(c.id, lc, ctx.buf);
+			const auto candidates = ctx.buf.getCandidates();
+			uint count = 0;
+
+			if(this->prefetchDistance && W.hasNext())
+				conn->prefetch(W.getNext().id, lc);
+
+			for(const auto& eID : N)
+				if(!ctx.visited.isMarked(eID)) {
+					ctx.visited.mark(eID);
+
+					if(!skipReused || !this->isReused(eID))
+						candidates[count++] = eID;
+				}
+
+			const auto distances = ctx.buf.getDistances();
+			this->space.getDistances(q, candidates, count, distances, this->prefetchDistance);
+
+			for(uint i = 0; i < count; i++)
+				W.push(distances[i], candidates[i]);
+
+			if(tracker && !tracker->expand(count, W))
+				break;
+		}
+	}
+
+	void AbstractIndex::searchLowerLayerFiltered(
+		const uint ef, const Node& ep, const float* const q, const IDFilter* const filter,
+		SearchContext& ctx, BudgetTracker* const tracker
+	) {
+		auto& C = ctx.candidates;
+		auto& W = ctx.results;
+		C.clear();
+		C.push(ep);
+		W.reset(ef);
+		ctx.visited.prepare(ep.id);
+		const auto conn = this->getConn();
+		const auto skipReused = this->reusing.load(std::memory_order_relaxed);
+
+		if((!filter || filter->isAllowed(ep.id)) && !this->isDeleted(ep.id))
+			W.push(ep.dist, ep.id);
+
+		// Disallowed and deleted nodes still carry the traversal, so the graph stays connected, but
+		// only the rest enter W. Candidates are kept apart from W and bounded by its farthest node.
+		while(C.len()) {
+			const auto c = C.extractTop();
+
+			if(W.len() == ef && c.dist > W.get(ef - 1).dist)
+				break;
+
+			const auto N = conn->getNeighbors(c.id, 0, ctx.buf);
+			const auto candidates = ctx.buf.getCandidates();
+			uint count = 0;
+
+			if(this->prefetchDistance && C.len())
+				conn->prefetch(C.top().id, 0);
+
+			for(const auto& eID : N)
+				if(!ctx.visited.isMarked(eID)) {
+					ctx.visited.mark(eID);
+
+					if(!skipReused || !this->isReused(eID))
+						candidates[count++] = eID;
+				}
+
+			const auto distances = ctx.buf.getDistances();
+			this->space.getDistances(q, candidates, count, distances, this->prefetchDistance);
+
+			for(uint i = 0; i < count; i++)
+				if(W.len() < ef || distances[i] < W.get(ef - 1).dist) {
+					const auto id = candidates[i];
+					C.push(Node(distances[i], id));
+
+					if((!filter || filter->isAllowed(id)) && !this->isDeleted(id))
+						W.push(distances[i], id);
+				}
+
+			if(tracker && !tracker->expand(count, W))
+				break;
+		}
+	}
+
+	void AbstractIndex::searchLowerLayerRange(
+		const float radius, const uint ef, const Node& ep, const float* const q,
+		SearchContext& ctx
+	) {
+		auto& C = ctx.candidates;
+		auto& R = ctx.inRange;
+		auto& W = ctx.results;
+		C.clear();
+		C.push(ep);
+		R.clear();
+		W.reset(ef);
+		W.push(ep.dist, ep.id);
+		ctx.visited.prepare(ep.id);
+		const auto conn = this->getConn();
+		const auto skipReused = this->reusing.load(std::memory_order_relaxed);
+
+		if(ep.dist <= radius && !this->isDeleted(ep.id))
+			R.push_back(ep);
+
+		// W keeps the usual beam of ef nodes, every node within the radius widens it further.
+		// The search ends once the closest candidate lies outside both the radius and the beam.
+		while(C.len()) {
+			const auto c = C.extractTop();
+
+			if(c.dist > radius && W.len() == ef && c.dist > W.get(ef - 1).dist)
+				break;
+
+			const auto N = conn->getNeighbors(c.id, 0, ctx.buf);
+			const auto candidates = ctx.buf.getCandidates();
+			uint count = 0;
+
+			if(this->prefetchDistance && C.len())
+				conn->prefetch(C.top().id, 0);
+
+			for(const auto& eID : N)
+				if(!ctx.visited.isMarked(eID)) {
+					ctx.visited.mark(eID);
+
+					if(!skipReused || !this->isReused(eID))
+						candidates[count++] = eID;
+				}
+
+			const auto distances = ctx.buf.getDistances();
+			this->space.getDistances(q, candidates, count, distances, this->prefetchDistance);
+
+			for(uint i = 0; i < count; i++) {
+				const Node e(distances[i], candidates[i]);
+
+				if(e.dist <= radius && !this->isDeleted(e.id))
+					R.push_back(e);
+				if(W.push(e.dist, e.id) || e.dist <= radius)
+					C.push(e);
+			}
+		}
+	}
+
+	Node AbstractIndex::searchUpperLayer(
+		const Node& ep, const uint lc, const float* const q, NeighborsBuffer& buf
+	) {
+		Node m = ep;
+		uint prev{};
+		const auto conn = this->getConn();
+		const auto skipReused = this->reusing.load(std::memory_order_relaxed);
+
+		do {
+			auto N = conn->getNeighbors(m.id, lc, buf);
+			prev = m.id;
+
+			if(skipReused) {
+				const auto candidates = buf.getCandidates();
+				uint count = 0;
+
+				for(const auto& eID : N)
+					if(!this->isReused(eID))
+						candidates[count++] = eID;
+
+				N = NeighborsView(candidates, count);
+			}
+
+			const auto distances = buf.getDistances();
+			this->space.getDistances(q, N.begin(), N.len(), distances, this->prefetchDistance);
+
+			for(uint i = 0; i < N.len(); i++)
+				if(distances[i] < m.dist) {
+					m.dist = distances[i];
+					m.id = N.begin()[i];
+				}
+
+		} while(m.id != prev);
+
+		return m;
+	}
+
+	Node AbstractIndex::searchUpperLayers(const float* const q, NeighborsBuffer& buf) {
+		const auto entry = this->entry.load(std::memory_order_acquire);
+		const auto entryID = uint(entry);
+		Node ep(this->space.getDistance(q, entryID), entryID);
+
+		for(auto lc = uint(entry >> 32); lc > 0; lc--)
+			ep = this->searchUpperLayer(ep, lc, q, buf);
+
+		return ep;
+	}
+
+	// Nodes that linked to a reused slot drop the link and pick replacements among its neighbors.
+	// Only neighbors of the slot are found this way, other in-links keep pointing at the new vector.
+	void AbstractIndex::repairNeighbors(const uint id, const uint lc, SearchContext& ctx) {
+		const auto conn = this->getConn();
+		const auto oldN = conn->getNeighbors(id, lc, ctx.buf);
+		const std::vector<uint> old(oldN.begin(), oldN.end());
+		const auto mLayer = lc ? this->cfg.mMax : this->cfg.mMax0;
+		std::vector<uint> candidates;
+		std::vector<float> distances;
+
+		for(const auto nID : old) {
+			const auto N = conn->getNeighbors(nID, lc, ctx.buf);
+
+			if(std::find(N.begin(), N.end(), id) == N.end())
+				continue;
+
+			candidates.clear();
+			ctx.visited.prepare(nID);
+			ctx.visited.mark(id);
+
+			// Slots still waiting to be relinked are skipped, their links describe the old vectors.
+			for(const auto& list : {N, NeighborsView(old.data(), uint(old.size()))})
+				for(const auto eID : list)
+					if(!ctx.visited.isMarked(eID) && !this->isReused(eID)) {
+						ctx.visited.mark(eID);
+						candidates.push_back(eID);
+					}
+
+			if(candidates.empty()) {
+				this->writeNeighbors(nID, lc, std::vector<Node>{});
+				continue;
+			}
+
+			const auto nQuery = this->space.prepareQuery(
+				this->space.getVector(nID, ctx.decoded.data()), ctx.nodeQuery.data()
+			);
+			distances.resize(candidates.size());
+			this->space.getDistances(
+				nQuery, candidates.data(), candidates.size(), distances.data(), 0
+			);
+			ctx.neighbors.reset(uint(candidates.size()));
+
+			for(size_t i = 0; i < candidates.size(); i++)
+				ctx.neighbors.push(distances[i], candidates[i]);
+
+			if(ctx.neighbors.len() > mLayer)
+				this->writeNeighbors(nID, lc, this->selectNeighbors(mLayer, ctx.neighbors, ctx));
+			else
+				this->writeNeighbors(nID, lc, ctx.neighbors);
+		}
+	}
+
+	const SearchBuffer& AbstractIndex::rerank(const float* const q, SearchContext& ctx) {
+		// Codes only steer the search, the candidates it found are ordered by their exact vectors.
+		const auto& W = ctx.results;
+		ctx.reranked.reset(W.len());
+
+		for(uint i = 0; i < W.len(); i++) {
+			const auto id = W.get(i).id;
+			ctx.reranked.push(this->space.getDistance(q, this->space.getData(id)), id);
+		}
+
+		return ctx.reranked;
+	}
+
+	void AbstractIndex::scanAllowed(
+		const uint ef, const float* const q, const IDFilter& filter, SearchContext& ctx
+	) {
+		auto& W = ctx.results;
+		W.reset(ef);
+		const auto candidates = ctx.buf.getCandidates();
+		const auto distances = ctx.buf.getDistances();
+		const uint elemCount = this->elemCount;
+		auto id = filter.findNext(0);
+
+		// Allowed IDs are gathered into blocks, so the batched kernels compute their distances.
+		while(id < elemCount) {
+			uint count = 0;
+
+			for(; id < elemCount && count < this->cfg.mMax0; id = filter.findNext(id + 1))
+				if(!this->isDeleted(id))
+					candidates[count++] = id;
+
+			this->space.getDistances(q, candidates, count, distances, this->prefetchDistance);
+
+			for(uint i = 0; i < count; i++)
+				W.push(distances[i], candidates[i]);
+		}
+	}
+
+	std::vector<Node> AbstractIndex::selectNeighbors(
+		const uint M, const SearchBuffer& W, SearchContext& ctx
+	) {
+		std::vector<Node> R;
+		R.reserve(M);
+
+		if(W.len() <= M) {
+			for(uint i = 0; i < W.len(); i++)
+				R.push_back(W.get(i));
+			return R;
+		}
+
+		for(uint i = 0; i < W.len() && R.size() < M; i++) {
+			auto close = true;
+			const auto e = W.get(i);
+			const auto eData = this->space.getVector(e.id, ctx.decoded.data());
+
+			for(const auto& r : R)
+				if(this->space.getDistance(
+					eData, this->space.getVector(r.id, ctx.neighborDecoded.data())
+				) < e.dist) {
+					close = false;
+					break;
 				}
+
+			if(close)
+				R.push_back(e);
+		}
+
+		return R;
+	}
+
+	// The level sits in the upper half so one atomic load always yields a matching pair.
+	static uint64_t packEntry(const uint id, const uint level) {
+		return uint64_t(level) << 32 | id;
+	}
+
+	InterleavedRecords* AbstractIndex::getRecords() {
+		return this->records.isEnabled() ? &this->records : nullptr;
+	}
+
+	void AbstractIndex::load(const IndexFilePtr& file) {
+		const auto& header = file->getHeader();
+		this->records.load(*file, header.elemCount);
+		this->space.load(*file, header.elemCount);
+		this->getConn()->load(*file, header.elemCount);
+		this->tombstones.load(*file, header.elemCount);
+		this->elemCount = header.elemCount;
+
+		for(uint id = 0; id < header.elemCount; id++)
+			if(this->isDeleted(id))
+				this->freeSlots.push_back(id);
+
+		if(this->freeSlots.size() != header.deletedCount)
+			throw std::runtime_error("Index file is corrupted.");
+
+		this->deletedCount = header.deletedCount;
+		this->entry.store(header.entry, std::memory_order_release);
+
+		// Mapped vectors and links point into the file, so it lives as long as the index.
+		if(file->isMapped())
+			this->file = file;
+	}
+
+	void AbstractIndex::prepareStorage(const ArrayView<const float>& v) {
+		// Quantization parameters come from the first batch and stay fixed for later ones.
+		if(!this->space.isTrained() && v.getElemCount())
+			this->space.train(v);
+
+		this->reserve(size_t(this->elemCount) + v.getElemCount());
+	}
+
+	size_t AbstractIndex::setupFirstElement(const ArrayView<const float>& v, LevelGenerator& gen) {
+		if(!this->elemCount) {
+			const auto level = gen.getNextLevel();
+			this->elemCount = 1;
+			this->getConn()->init(0, level);
+			this->space.push(Element(v.getData(0), 0));
+			this->entry.store(packEntry(0, level), std::memory_order_release);
+			return 1;
+		}
+		return 0;
+	}
+
+	AbstractIndex::AbstractIndex(
+		IndexConfig cfg, const size_t dim, const SpaceKind spaceKind, const SIMDType simdType
+	) : deletedCount(0), elemCount(0), entry(0), file(nullptr), filterMode(FilterMode::AUTO),
+		prefetchDistance(0), reusing(false), tombstones(1, cfg.maxElemCount), cfg(cfg),
+		records(this->cfg, dim),
+		space(
+			dim, spaceKind, this->cfg.maxElemCount, simdType, this->getRecords(), this->cfg.storage,
+			this->cfg.rerank, this->cfg.pqSubspaces, this->cfg.padded
+		), contextPool(this->cfg, this->space) {
+
+		if(this->cfg.storage != VectorStorage::FLOAT && this->cfg.layout == StorageLayout::INTERLEAVED)
+			throw std::runtime_error("Quantized storage needs the split layout.");
+	}
+
+	size_t AbstractIndex::getCapacity() const {
+		return this->space.getCapacity();
+	}
+
+	uint AbstractIndex::getDeletedCount() const {
+		return this->deletedCount.load(std::memory_order_relaxed);
+	}
+
+	uint AbstractIndex::getEntryID() const {
+		return uint(this->entry.load(std::memory_order_acquire));
+	}
+
+	uint AbstractIndex::getEntryLevel() const {
+		return uint(this->entry.load(std::memory_order_acquire) >> 32);
+	}
+
+	std::string AbstractIndex::getString() const {
+		std::stringstream s;
+		s << "(efConstruction = " << this->cfg.efConstruction << ", mMax = " << this->cfg.mMax <<
+			", distance = " << this->space.getDistanceName() <<
+			", layout = " << storageLayoutToStr(this->cfg.layout) <<
+			", storage = " << vectorStorageToStr(this->space.storage);
+
+		if(this->space.storage == VectorStorage::PQ)
+			s << ' ' << this->cfg.pqSubspaces;
+		if(this->cfg.rerank)
+			s << " reranked";
+		if(this->cfg.padded)
+			s << " padded";
+
+		s << ", prefetch = " << this->prefetchDistance << ')';
+		return s.str();
+	}
+
+	std::vector<uint> AbstractIndex::insert(const ArrayView<const float>& v) {
+		// Deleted slots are claimed in small rounds. Unclaimed ones keep routing searches with their
+		// old vectors, claimed ones are skipped until relinked.
+		constexpr size_t roundLen = 64;
+		std::unique_lock<std::mutex> appendLock(this->appendMutex);
+		std::vector<uint> ids;
+
+		while(ids.size() < v.getElemCount()) {
+			const auto first = ids.size();
+			const auto claimed = this->claimDeletedSlots(
+				std::min(roundLen, v.getElemCount() - first)
+			);
+
+			if(claimed.empty())
+				break;
+
+			// Searches still reach claimed slots through old links, so none may run meanwhile.
+			{
+				std::unique_lock<std::shared_mutex> lock(this->vectorsMutex);
+
+				for(size_t i = 0; i < claimed.size(); i++)
+					this->space.push(Element(v.getData(first + i), claimed[i]));
+
+				this->reusing.store(true, std::memory_order_relaxed);
+			}
+
+			this->reuseSlots(
+				ArrayView<const float>(v.getData(first), v.getDim(), claimed.size()), claimed
+			);
+			ids.insert(ids.end(), claimed.begin(), claimed.end());
+		}
+
+		this->reusing.store(false, std::memory_order_relaxed);
+		const auto reusedCount = ids.size();
+		const auto firstID = this->elemCount.load();
+
+		if(reusedCount < v.getElemCount()) {
+			const auto appendedCount = v.getElemCount() - reusedCount;
+			this->append(ArrayView<const float>(v.getData(reusedCount), v.getDim(), appendedCount));
+
+			for(size_t i = 0; i < appendedCount; i++)
+				ids.push_back(firstID + uint(i));
+		}
+
+		return ids;
+	}
+
+	uint AbstractIndex::insertWithLevel(const Element& q, const uint l, SearchContext& ctx) {
+		this->getConn()->init(q.id, l);
+		this->space.push(q);
+		return this->linkElement(q, l, ctx, 0);
+	}
+
+	bool AbstractIndex::isDeleted(const uint id) const {
+		return this->tombstones.getData(id)->load(std::memory_order_relaxed) != Tombstone::LIVE;
+	}
+
+	bool AbstractIndex::isReused(const uint id) const {
+		return this->tombstones.getData(id)->load(std::memory_order_relaxed) == Tombstone::REUSED;
+	}
+
+	void AbstractIndex::markDeleted(const uint id) {
+		if(this->file)
+			throw std::runtime_error("Index mapped from a file is read-only.");
+		if(id >= this->elemCount)
+			throw std::runtime_error("Element ID is out of range.");
+
+		auto expected = Tombstone::LIVE;
+
+		if(!this->tombstones.getData(id)->compare_exchange_strong(expected, Tombstone::DELETED))
+			return;
+
+		this->deletedCount++;
+		std::unique_lock<std::mutex> lock(this->freeSlotsMutex);
+		this->freeSlots.push_back(id);
+	}
+
+	bool AbstractIndex::promoteEntry(const uint id, const uint level) {
+		auto curr = this->entry.load(std::memory_order_relaxed);
+
+		// Only a higher level replaces the entry, so racing promotions settle on the highest one.
+		while(level > uint(curr >> 32))
+			if(this->entry.compare_exchange_weak(
+				curr, packEntry(id, level), std::memory_order_release, std::memory_order_relaxed
+			))
+				return true;
+
+		return false;
+	}
+
+	// A filtered graph search expands about ef / selectivity nodes with up to mMax0 neighbors each,
+	// while a scan computes one distance per allowed ID.
+	static bool useBruteforce(
+		const FilterMode mode, const IDFilter& filter, const uint ef, const uint mMax0,
+		const uint elemCount
+	) {
+		switch(mode) {
+			case FilterMode::AUTO: {
+				const auto allowed = uint64_t(filter.getAllowedCount());
+				return allowed * allowed <= uint64_t(ef) * mMax0 * elemCount;
+			}
+			case FilterMode::BRUTEFORCE:
+				return true;
+			case FilterMode::GRAPH:
+				return false;
+			default:
+				throw std::runtime_error("Unknown filter mode.");
 		}
 
-		return W;
+		return false;
 	}
 
-	Node AbstractIndex::searchUpperLayer(const Node& ep, const uint lc, const float* const q) {
-		Node m = ep;
-		uint prev{};
+	static void checkQueryParams(
+		const std::vector<uint>& efSearch, const std::vector<uint>& k, const size_t queryCount
+	) {
+		if(efSearch.size() != queryCount || k.size() != queryCount)
+			throw std::runtime_error("EfSearch and k need one value per query.");
+	}
 
-		do {
-			const auto N = this->getConn()->getNeighbors(m.id, lc);
-			prev = m.id;
+	static void checkFilterCount(const std::vector<IDFilter>& filters, const size_t queryCount) {
+		if(filters.size() > 1 && filters.size() != queryCount)
+			throw std::runtime_error("Filter count must be 1 or match the query count.");
+	}
 
-			for(const auto& cand : *N) {
-				const auto dist = this->space.getDistance(cand, q);
+	static const IDFilter* getQueryFilter(
+		const std::vector<IDFilter>& filters, const size_t queryIdx
+	) {
+		if(filters.empty())
+			return nullptr;
+		return filters.size() == 1 ? &filters.front() : &filters[queryIdx];
+	}
 
-				if(dist < m.dist) {
-					m.dist = dist;
-					m.id = cand;
-				}
-			}
+	void AbstractIndex::push(const ArrayView<const float>& v) {
+		std::unique_lock<std::mutex> lock(this->appendMutex);
+		this->append(v);
+	}
 
-		} while(m.id != prev);
+	void AbstractIndex::setFilterMode(const FilterMode mode) {
+		this->filterMode = mode;
+	}
 
-		return m;
+	void AbstractIndex::setPrefetchDistance(const uint d) {
+		this->prefetchDistance = d;
 	}
 
-	std::vector<Node> AbstractIndex::selectNeighbors(
-		const uint M, const float* const q, NearHeap& W
-	) {
-		std::vector<Node> R;
-		R.reserve(M);
+	void AbstractIndex::setSearchBudget(const SearchBudget& budget) {
+		this->searchBudget = budget;
+	}
 
-		if(W.len() <= M) {
-			while(W.len())
-				R.push_back(W.extractTop());
-			return R;
+	const SearchBuffer& AbstractIndex::query(
+		const float* const q, const uint efSearch, const uint k, SearchContext& ctx,
+		const IDFilter* const filter
+	) {
+		const auto lock = this->lockVectors();
+		const auto efMax = std::max(efSearch, k);
+		BudgetTracker tracker(this->searchBudget, k);
+		const auto trackerPtr = this->searchBudget.isLimited() ? &tracker : nullptr;
+		const auto query = this->space.prepareQuery(q, ctx.query.data());
+
+		if(filter && useBruteforce(
+			this->filterMode, *filter, efMax, this->cfg.mMax0, this->elemCount
+		))
+			this->scanAllowed(efMax, query, *filter, ctx);
+		else {
+			const auto ep = this->searchUpperLayers(query, ctx.buf);
+
+			if(filter || this->deletedCount.load(std::memory_order_relaxed))
+				this->searchLowerLayerFiltered(efMax, ep, query, filter, ctx, trackerPtr);
+			else
+				this->searchLowerLayer(efMax, ep, 0, query, ctx, trackerPtr);
 		}
 
-		while(W.len() && R.size() < M) {
-			auto close = true;
-			auto e = W.extractTop();
+		if(this->cfg.rerank && this->space.storage != VectorStorage::FLOAT)
+			return this->rerank(q, ctx);
 
-			for(const auto& r : R)
-				if(this->space.getDistance(e.id, r.id) < e.dist) {
-					close = false;
-					break;
-				}
+		return ctx.results;
+	}
 
-			if(close)
-				R.push_back(e);
+	const std::vector<Node>& AbstractIndex::rangeQuery(
+		const float* const q, const float radius, const uint efSearch, SearchContext& ctx
+	) {
+		const auto lock = this->lockVectors();
+		const auto query = this->space.prepareQuery(q, ctx.query.data());
+		const auto ep = this->searchUpperLayers(query, ctx.buf);
+		this->searchLowerLayerRange(radius, efSearch, ep, query, ctx);
+		auto& R = ctx.inRange;
+
+		// Codes only steer the search, the radius is checked against the exact vectors.
+		if(this->cfg.rerank && this->space.storage != VectorStorage::FLOAT) {
+			for(auto& n : R)
+				n.dist = this->space.getDistance(q, this->space.getData(n.id));
+
+			R.erase(std::remove_if(R.begin(), R.end(), [radius](const Node& n) {
+				return n.dist > radius;
+			}), R.end());
 		}
 
+		std::sort(R.begin(), R.end(), FarHeapCmp());
 		return R;
 	}
 
-	size_t AbstractIndex::setupFirstElement(const ArrayView<const float>& v, LevelGenerator& gen) {
-		if(!this->elemCount) {
-			this->elemCount = 1;
-			this->entryLevel = gen.getNextLevel();
-			this->getConn()->init(0, this->entryLevel);
-			this->space.push(Element(v.getData(0), 0));
-			return 1;
-		}
-		return 0;
-	}
+	void AbstractIndex::reinsert(const Element& q, SearchContext& ctx) {
+		// The slot keeps its level, so readers never see its upper layers reallocated.
+		const auto l = this->getConn()->getLevel(q.id);
 
-	AbstractIndex::AbstractIndex(
-		IndexConfig cfg, const size_t dim, const SpaceKind spaceKind, const SIMDType simdType
-	) : elemCount(0), entryID(0), entryLevel(0), cfg(cfg),
-		space(dim, spaceKind, this->cfg.maxElemCount, simdType) {}
+		for(uint lc = 0; lc <= l; lc++)
+			this->repairNeighbors(q.id, lc, ctx);
 
-	uint AbstractIndex::getEntryLevel() const {
-		return this->entryLevel;
+		this->linkElement(q, l, ctx, 0);
+		this->tombstones.getData(q.id)->store(Tombstone::LIVE, std::memory_order_release);
+		this->deletedCount--;
 	}
 
-	std::string AbstractIndex::getString() const {
-		std::stringstream s;
-		s << "(efConstruction = " << this->cfg.efConstruction << ", mMax = " << this->cfg.mMax <<
-			", distance = " << this->space.getDistanceName() << ')';
-		return s.str();
+	void AbstractIndex::relinkUpperLayers(
+		const Element& q, const uint L, const uint l, SearchContext& ctx
+	) {
+		this->linkElement(q, l, ctx, L + 1);
+	}
+
+	void AbstractIndex::reserve(const size_t count) {
+		if(this->file)
+			throw std::runtime_error("Index mapped from a file is read-only.");
+		if(count > size_t(std::numeric_limits<uint>::max()))
+			throw std::runtime_error("Element count exceeds the range of IDs.");
+
+		// Existing records stay in place, so searches running on other threads are not disturbed.
+		this->records.reserve(count);
+		this->space.reserve(count);
+		this->getConn()->reserve(count);
+		this->tombstones.reserve(count);
+	}
+
+	void AbstractIndex::save(const std::string& path) {
+		std::ofstream s(path, std::ios::binary);
+
+		if(!s)
+			throw std::runtime_error("Could not create index file " + path + '.');
+
+		IndexFileHeader header;
+		header.dim = uint32_t(this->space.dim);
+		header.efConstruction = this->cfg.efConstruction;
+		header.mMax = this->cfg.mMax;
+		header.maxElemCount = this->cfg.maxElemCount;
+		header.layout = uint32_t(this->cfg.layout);
+		header.spaceKind = uint32_t(this->space.kind);
+		header.elemCount = this->elemCount;
+		header.entry = this->entry.load(std::memory_order_acquire);
+		header.mL = this->cfg.getML();
+		header.storage = uint32_t(this->space.storage);
+		header.rerank = this->cfg.rerank;
+		header.pqSubspaces = this->cfg.pqSubspaces;
+		header.padded = this->cfg.padded;
+		header.deletedCount = this->deletedCount;
+
+		// Saving reads the graph without locks, so no insertion may run meanwhile.
+		this->getConn()->fillHeader(header, this->elemCount);
+		IndexFile::writeHeader(s, header);
+		this->records.save(s, this->elemCount);
+		this->space.save(s, this->elemCount);
+		this->getConn()->save(s, this->elemCount);
+		this->tombstones.save(s, this->elemCount);
+
+		if(!s)
+			throw std::runtime_error("Could not write index file " + path + '.');
+	}
+
+	void AbstractIndex::unmarkDeleted(const uint id) {
+		if(this->file)
+			throw std::runtime_error("Index mapped from a file is read-only.");
+		if(id >= this->elemCount)
+			throw std::runtime_error("Element ID is out of range.");
+
+		auto expected = Tombstone::DELETED;
+
+		if(this->tombstones.getData(id)->compare_exchange_strong(expected, Tombstone::LIVE))
+			this->deletedCount--;
+	}
+
+	// A copied index keeps growing from its saved size, a mapped one never allocates its records.
+	static IndexConfig getFileConfig(const IndexFile& file) {
+		const auto& header = file.getHeader();
+		return IndexConfig(
+			header.efConstruction, header.mMax,
+			file.isMapped() ? 0 : std::max(header.maxElemCount, header.elemCount),
+			StorageLayout(header.layout), header.mL, VectorStorage(header.storage), header.rerank != 0,
+			header.pqSubspaces, header.padded != 0
+		);
 	}
 
-	void AbstractIndex::insertWithLevel(const Element& q, const uint l) {
-		this->getConn()->init(q.id, l);
-		this->space.push(q);
+	std::string chunkPolicyToStr(const ChunkPolicy policy) {
+		switch(policy) {
+			case ChunkPolicy::FIXED:
+				return "fixed";
+			case ChunkPolicy::GUIDED:
+				return "guided";
+			default:
+				throw std::runtime_error("Unknown chunk policy.");
+		}
 
-		Node ep(this->space.getDistance(this->entryID, q.data), this->entryID);
-		const auto L = this->entryLevel;
-		auto lc = L;
+		return "";
+	}
 
-		while(lc > l) {
-			ep = this->searchUpperLayer(ep, lc, q.data);
-			lc--;
-		}
+	Element ThreadSafeFloatView::getElement(const size_t i) const {
+		return Element(this->v.getData(i), this->ids ? this->ids[i] : this->idOffset + uint(i));
+	}
 
-		lc = std::min(L, l);
+	bool ThreadSafeFloatView::getNextChunk(size_t& first, size_t& last) {
+		const auto count = this->v.getElemCount();
+		auto curr = this->currID.load(std::memory_order_relaxed);
 
 		for(;;) {
-			ep = this->processLowerLayer(ep, lc, q);
-
-			if(!lc)
-				break;
+			if(curr >= count)
+				return false;
 
-			lc--;
-		}
-	}
+			// Guided chunks shrink with the remaining work, so the tail stays balanced.
+			auto len = this->chunkSize;
 
-	void AbstractIndex::setEntry(const uint id, const uint level) {
-		this->entryID = id;
-		this->entryLevel = level;
-	}
+			if(this->policy == ChunkPolicy::GUIDED)
+				len = std::max(len, (count - curr) / (2 * this->workersNum));
 
-	FarHeap AbstractIndex::query(const float* const q, const uint efSearch, const uint k) {
-		const auto efMax = std::max(efSearch, k);
-		Node ep(this->space.getDistance(this->entryID, q), this->entryID);
-		const auto L = this->entryLevel;
-		auto lc = L;
+			len = std::min(len, count - curr);
 
-		while(lc > 0) {
-			ep = this->searchUpperLayer(ep, lc, q);
-			lc--;
+			if(this->currID.compare_exchange_weak(curr, curr + len, std::memory_order_relaxed)) {
+				first = curr;
+				last = curr + len;
+				return true;
+			}
 		}
+	}
 
-		auto W = this->searchLowerLayer(efMax, ep, 0, q, true);
+	ThreadSafeFloatView::ThreadSafeFloatView(
+		const uint idOffset, const ArrayView<const float>& v, const size_t firstID,
+		const ChunkPolicy policy, const size_t chunkSize, const size_t workersNum,
+		const uint* const ids
+	) : chunkSize(chunkSize), currID(firstID), ids(ids), idOffset(idOffset), policy(policy), v(v),
+		workersNum(std::max(workersNum, size_t(1))) {}
 
-		while(W.len() > k)
-			W.pop();
+	void ParallelIndex::append(const ArrayView<const float>& v) {
+		const auto idOffset = this->elemCount.load();
+		LevelGenerator gen(this->cfg.getML(), this->levelGenSeed);
+		const auto seedOffset = this->levelGenSeed + 1;
+		const auto workersNum = std::min(this->pool->getWorkersNum(), v.getElemCount());
+		std::vector<ParallelInsertWorker> workers;
+		workers.reserve(workersNum);
+		this->prepareStorage(v);
 
-		return W;
-	}
+		const auto firstID = this->setupFirstElement(v, gen);
+		ThreadSafeFloatView elemView(
+			idOffset, v, firstID, this->chunkPolicy, this->chunkSize, workersNum
+		);
 
-	Element ThreadSafeFloatView::getNextElement() {
-		std::unique_lock<std::mutex> lock(this->m);
+		for(size_t i = 0; i < workersNum; i++)
+			workers.emplace_back(this, &elemView, seedOffset + uint(i));
 
-		if(this->currID == v.getElemCount())
-			return Element::fail();
+		this->pool->run(workers.size(), [&workers](const size_t i) { workers[i].run(); });
 
-		Element res(this->v.getData(this->currID), this->idOffset + uint(this->currID));
-		this->currID++;
-		return res;
+		this->elemCount = idOffset + uint(v.getElemCount());
 	}
 
-	ThreadSafeFloatView::ThreadSafeFloatView(const uint idOffset, const ArrayView<const float>& v)
-		: currID(0), idOffset(idOffset), v(v) {}
-
 	Connections* ParallelIndex::getConn() {
 		return &this->conn;
 	}
 
-	VisitedPtr ParallelIndex::getVisitedSet(const Node& ep) {
-		return std::make_shared<VisitedSet>(this->cfg.maxElemCount, ep.id);
-	}
-
 	void ParallelIndex::writeNeighbors(const uint id, const uint lc, const std::vector<Node>& R) {
-		std::unique_lock<std::mutex> lock(this->conn.getMutex(id));
+		this->conn.lock(id);
+		this->conn.beginWrite(id);
 		auto N = this->conn.getWritableNeighbors(id, lc);
 		N.clear();
 
 		for(const auto& r : R)
 			N.push(r.id);
-	}
 
-	void ParallelIndex::writeNeighbors(
-		const uint id, const uint lc, NeighborsPtr, const std::vector<Node>& R
-	) {
-		this->writeNeighbors(id, lc, R);
+		this->conn.endWrite(id);
+		this->conn.unlock(id);
 	}
 
-	void ParallelIndex::writeNeighbors(const uint id, const uint lc, NeighborsPtr, NearHeap& R) {
-		std::unique_lock<std::mutex> lock(this->conn.getMutex(id));
+	void ParallelIndex::writeNeighbors(const uint id, const uint lc, const SearchBuffer& R) {
+		this->conn.lock(id);
+		this->conn.beginWrite(id);
 		auto N = this->conn.getWritableNeighbors(id, lc);
 		N.clear();
 
-		while(R.len())
-			N.push(R.extractTop().id);
+		for(uint i = 0; i < R.len(); i++)
+			N.push(R.get(i).id);
+
+		this->conn.endWrite(id);
+		this->conn.unlock(id);
 	}
 
 	std::string ParallelIndex::getString() const {
 		std::stringstream s;
-		s << "ParallelIndex" << AbstractIndex::getString() << "[workers = " << this->workersNum << ']';
+		s << "ParallelIndex" << AbstractIndex::getString() << "[workers = " << this->pool->getWorkersNum() <<
+			", reads = " << (this->conn.hasOptimisticReads() ? "optimistic" : "locked") <<
+			", locks = " << lockModeToStr(this->conn.getLockMode());
+
+		if(this->conn.getStripeCount())
+			s << ' ' << this->conn.getStripeCount();
+
+		s << ", chunks = " << chunkPolicyToStr(this->chunkPolicy) << ' ' << this->chunkSize << ']';
 		return s.str();
 	}
 
 	ParallelIndex::ParallelIndex(
 		const IndexConfig& cfg, const size_t dim, const uint levelGenSeed,
-		const SpaceKind spaceKind, const SIMDType simdType
-	) : AbstractIndex(cfg, dim, spaceKind, simdType),
-		conn(this->cfg.maxElemCount, this->cfg.mMax, this->cfg.mMax0), levelGenSeed(levelGenSeed),
-		workersNum(1) {}
+		const SpaceKind spaceKind, const SIMDType simdType,
+		const LockMode lockMode, const size_t stripeCount
+	) : AbstractIndex(cfg, dim, spaceKind, simdType), chunkPolicy(ChunkPolicy::GUIDED), chunkSize(1),
+		conn(
+			this->cfg.maxElemCount, this->cfg.mMax, this->cfg.mMax0, lockMode, stripeCount,
+			this->getRecords()
+		),
+		levelGenSeed(levelGenSeed), pool(std::make_shared<ThreadPool>(1)) {}
 
-	void ParallelIndex::push(const ArrayView<const float>& v) {
-		ThreadSafeFloatView elemView(this->elemCount, v);
-		LevelGenerator gen(this->cfg.getML(), this->levelGenSeed);
-		const auto seedOffset = this->levelGenSeed + 1;
-		std::vector<ParallelInsertWorker> workers;
-		workers.reserve(this->workersNum);
+	ParallelIndex::ParallelIndex(
+		const IndexFilePtr& file, const uint levelGenSeed, const SIMDType simdType,
+		const LockMode lockMode, const size_t stripeCount
+	) : ParallelIndex(
+			getFileConfig(*file), file->getHeader().dim, levelGenSeed,
+			SpaceKind(file->getHeader().spaceKind), simdType, lockMode, stripeCount
+		) {
 
-		if(this->setupFirstElement(v, gen))
-			(void)elemView.getNextElement();
+		this->load(file);
+	}
 
-		for(size_t i = 0; i < this->workersNum; i++)
-			workers.emplace_back(this, &elemView, seedOffset + uint(i));
-		for(auto& w : workers)
-			w.start();
-		for(auto& w : workers)
-			w.join();
+	void ParallelIndex::reuseSlots(const ArrayView<const float>& v, const std::vector<uint>& ids) {
+		const auto workersNum = std::min(this->pool->getWorkersNum(), v.getElemCount());
+		ThreadSafeFloatView elemView(
+			0, v, 0, this->chunkPolicy, this->chunkSize, workersNum, ids.data()
+		);
+		std::vector<ParallelReinsertWorker> workers;
+		workers.reserve(workersNum);
+
+		for(size_t i = 0; i < workersNum; i++)
+			workers.emplace_back(this, &elemView);
 
-		this->elemCount += uint(v.getElemCount());
+		this->pool->run(workers.size(), [&workers](const size_t i) { workers[i].run(); });
 	}
 
 	QueryResPtr ParallelIndex::queryBatch(
-		const ArrayView<const float>& v, const uint efSearch, const uint k
+		const ArrayView<const float>& v, const uint efSearch, const uint k,
+		const std::vector<IDFilter>& filters
 	) {
-		ThreadSafeFloatView elemView(0, v);
+		checkFilterCount(filters, v.getElemCount());
 		auto res = std::make_shared<QueryResults>(size_t(k), v.getElemCount());
+		const auto workersNum = std::min(this->pool->getWorkersNum(), v.getElemCount());
+		ThreadSafeFloatView elemView(0, v, 0, this->chunkPolicy, this->chunkSize, workersNum);
 		std::vector<ParallelQueryWorker> workers;
-		workers.reserve(this->workersNum);
+		workers.reserve(workersNum);
+
+		for(size_t i = 0; i < workersNum; i++)
+			workers.emplace_back(this, &elemView, efSearch, k, res, filters);
+
+		this->pool->run(workers.size(), [&workers](const size_t i) { workers[i].run(); });
+
+		return res;
+	}
 
-		for(size_t i = 0; i < this->workersNum; i++)
+	RaggedResPtr ParallelIndex::queryBatch(
+		const ArrayView<const float>& v, const std::vector<uint>& efSearch,
+		const std::vector<uint>& k
+	) {
+		checkQueryParams(efSearch, k, v.getElemCount());
+		auto res = std::make_shared<RaggedResults>(k);
+		const auto workersNum = std::min(this->pool->getWorkersNum(), v.getElemCount());
+		ThreadSafeFloatView elemView(0, v, 0, this->chunkPolicy, this->chunkSize, workersNum);
+		std::vector<ParallelRaggedQueryWorker> workers;
+		workers.reserve(workersNum);
+
+		for(size_t i = 0; i < workersNum; i++)
 			workers.emplace_back(this, &elemView, efSearch, k, res);
-		for(auto& w : workers)
-			w.start();
-		for(auto& w : workers)
-			w.join();
 
+		this->pool->run(workers.size(), [&workers](const size_t i) { workers[i].run(); });
+
+		res->trim();
 		return res;
 	}
 
+	RaggedResPtr ParallelIndex::rangeQueryBatch(
+		const ArrayView<const float>& v, const float radius, const uint efSearch
+	) {
+		std::vector<std::vector<Node>> lists(v.getElemCount());
+		const auto workersNum = std::min(this->pool->getWorkersNum(), v.getElemCount());
+		ThreadSafeFloatView elemView(0, v, 0, this->chunkPolicy, this->chunkSize, workersNum);
+		std::vector<ParallelRangeWorker> workers;
+		workers.reserve(workersNum);
+
+		for(size_t i = 0; i < workersNum; i++)
+			workers.emplace_back(this, &elemView, radius, efSearch, lists);
+
+		this->pool->run(workers.size(), [&workers](const size_t i) { workers[i].run(); });
+
+		return std::make_shared<RaggedResults>(lists);
+	}
+
+	void ParallelIndex::setChunkPolicy(const ChunkPolicy policy, const size_t chunkSize) {
+		if(!chunkSize)
+			throw std::runtime_error("Chunk size must be positive.");
+
+		this->chunkPolicy = policy;
+		this->chunkSize = chunkSize;
+	}
+
+	void ParallelIndex::setOptimisticReads(const bool optimisticReads) {
+		this->conn.setOptimisticReads(optimisticReads);
+	}
+
+	void ParallelIndex::setThreadPool(const ThreadPoolPtr& pool) {
+		if(!pool)
+			throw std::runtime_error("Thread pool must not be null.");
+		this->pool = pool;
+	}
+
 	void ParallelIndex::setWorkersNum(const size_t n) {
 		if(!n)
 			throw std::runtime_error("Workers number must be positive.");
-		this->workersNum = n;
+		if(n != this->pool->getWorkersNum())
+			this->pool = std::make_shared<ThreadPool>(n);
 	}
 
-	std::mutex& ParallelIndex::getEntryPointMutex() {
-		return this->entryPointMutex;
+	size_t ParallelIndex::getLockBytes() const {
+		return this->conn.getLockBytes();
 	}
 
-	void ParallelWorker::join() {
-		this->t.join();
+	Element ParallelWorker::getNextElement() {
+		if(this->nextIdx == this->chunkEnd) {
+			if(!this->elemView->getNextChunk(this->nextIdx, this->chunkEnd))
+				return Element::fail();
+		}
+
+		return this->elemView->getElement(this->nextIdx++);
 	}
 
 	ParallelWorker::ParallelWorker(ParallelIndex* const index, ThreadSafeFloatView* const elemView)
-		: elemView(elemView), index(index), t{} {}
-
-	void ParallelWorker::start() {
-		this->t = std::thread(&ParallelWorker::run, this);
-	}
+		: chunkEnd(0), elemView(elemView), nextIdx(0), index(index) {}
 
 	void ParallelInsertWorker::run() {
 		LevelGenerator gen(this->index->cfg.getML(), this->levelGenSeed);
+		const auto ctx = this->index->contextPool.acquire();
 
 		for(;;) {
-			const auto e = this->elemView->getNextElement();
+			const auto e = this->getNextElement();
 
 			if(!e.data)
 				break;
 
+			// A new top-level node links below the current entry first and is published after.
 			const auto l = gen.getNextLevel();
-			std::unique_lock<std::mutex> lock(this->index->getEntryPointMutex());
-			const auto isNewEntry = l > this->index->getEntryLevel();
+			const auto L = this->index->insertWithLevel(e, l, *ctx);
 
-			if(!isNewEntry)
-				lock.unlock();
-
-			this->index->insertWithLevel(e, l);
-
-			if(isNewEntry)
-				this->index->setEntry(e.id, l);
+			// A racing insert won the promotion, so the layers above L still have no neighbors.
+			if(!this->index->promoteEntry(e.id, l) && l > L)
+				this->index->relinkUpperLayers(e, L, l, *ctx);
 		}
+
+		this->index->contextPool.release(ctx);
 	}
 
 	ParallelInsertWorker::ParallelInsertWorker(
 		ParallelIndex* const index, ThreadSafeFloatView* const elemView, const uint levelGenSeed
 	) : ParallelWorker(index, elemView), levelGenSeed(levelGenSeed) {}
 
+	void ParallelReinsertWorker::run() {
+		const auto ctx = this->index->contextPool.acquire();
+
+		for(;;) {
+			const auto e = this->getNextElement();
+
+			if(!e.data)
+				break;
+
+			this->index->reinsert(e, *ctx);
+		}
+
+		this->index->contextPool.release(ctx);
+	}
+
+	ParallelReinsertWorker::ParallelReinsertWorker(
+		ParallelIndex* const index, ThreadSafeFloatView* const elemView
+	) : ParallelWorker(index, elemView) {}
+
 	void ParallelQueryWorker::run() {
+		const auto ctx = this->index->contextPool.acquire();
+
 		if(this->index->space.normalize) {
 			std::vector<float> normQuery(this->index->space.dim, 0.f);
 
 			for(;;) {
-				const auto e = this->elemView->getNextElement();
+				const auto e = this->getNextElement();
 
 				if(!e.data)
 					break;
 
 				this->index->space.normalizeData(e.data, normQuery.data());
-				res->push(this->index->query(normQuery.data(), this->efSearch, this->k), e.id);
+				res->push(
+					this->index->query(
+						normQuery.data(), this->efSearch, this->k, *ctx,
+						getQueryFilter(this->filters, e.id)
+					), e.id
+				);
 			}
 
 		} else {
 			for(;;) {
-				const auto e = this->elemView->getNextElement();
+				const auto e = this->getNextElement();
 
 				if(!e.data)
 					break;
 
-				res->push(this->index->query(e.data, this->efSearch, this->k), e.id);
+				res->push(
+					this->index->query(
+						e.data, this->efSearch, this->k, *ctx, getQueryFilter(this->filters, e.id)
+					), e.id
+				);
 			}
 		}
+
+		this->index->contextPool.release(ctx);
 	}
 
 	ParallelQueryWorker::ParallelQueryWorker(
 		ParallelIndex* const index, ThreadSafeFloatView* const elemView,
-		const uint efSearch, const uint k, const QueryResPtr res
+		const uint efSearch, const uint k, const QueryResPtr res,
+		const std::vector<IDFilter>& filters
+	) : ParallelWorker(index, elemView), efSearch(efSearch), filters(filters), k(k), res(res) {}
+
+	void ParallelRaggedQueryWorker::run() {
+		const auto ctx = this->index->contextPool.acquire();
+
+		if(this->index->space.normalize) {
+			std::vector<float> normQuery(this->index->space.dim, 0.f);
+
+			for(;;) {
+				const auto e = this->getNextElement();
+
+				if(!e.data)
+					break;
+
+				this->index->space.normalizeData(e.data, normQuery.data());
+				res->push(
+					this->index->query(normQuery.data(), this->efSearch[e.id], this->k[e.id], *ctx),
+					e.id
+				);
+			}
+
+		} else {
+			for(;;) {
+				const auto e = this->getNextElement();
+
+				if(!e.data)
+					break;
+
+				res->push(
+					this->index->query(e.data, this->efSearch[e.id], this->k[e.id], *ctx), e.id
+				);
+			}
+		}
+
+		this->index->contextPool.release(ctx);
+	}
+
+	ParallelRaggedQueryWorker::ParallelRaggedQueryWorker(
+		ParallelIndex* const index, ThreadSafeFloatView* const elemView,
+		const std::vector<uint>& efSearch, const std::vector<uint>& k, const RaggedResPtr res
 	) : ParallelWorker(index, elemView), efSearch(efSearch), k(k), res(res) {}
 
-	Connections* SequentialIndex::getConn() {
-		return &this->conn;
+	void ParallelRangeWorker::run() {
+		const auto ctx = this->index->contextPool.acquire();
+
+		if(this->index->space.normalize) {
+			std::vector<float> normQuery(this->index->space.dim, 0.f);
+
+			for(;;) {
+				const auto e = this->getNextElement();
+
+				if(!e.data)
+					break;
+
+				this->index->space.normalizeData(e.data, normQuery.data());
+				this->lists[e.id] = this->index->rangeQuery(
+					normQuery.data(), this->radius, this->efSearch, *ctx
+				);
+			}
+
+		} else {
+			for(;;) {
+				const auto e = this->getNextElement();
+
+				if(!e.data)
+					break;
+
+				this->lists[e.id] = this->index->rangeQuery(
+					e.data, this->radius, this->efSearch, *ctx
+				);
+			}
+		}
+
+		this->index->contextPool.release(ctx);
+	}
+
+	ParallelRangeWorker::ParallelRangeWorker(
+		ParallelIndex* const index, ThreadSafeFloatView* const elemView, const float radius,
+		const uint efSearch, std::vector<std::vector<Node>>& lists
+	) : ParallelWorker(index, elemView), efSearch(efSearch), lists(lists), radius(radius) {}
+
+	void SequentialIndex::append(const ArrayView<const float>& v) {
+		this->prepareStorage(v);
+		const auto ctx = this->contextPool.acquire();
+
+		for(auto i = this->setupFirstElement(v, this->gen); i < v.getElemCount(); i++) {
+			const auto l = this->gen.getNextLevel();
+			this->insertWithLevel(Element(v.getData(i), this->elemCount), l, *ctx);
+			this->promoteEntry(this->elemCount, l);
+
+			this->elemCount++;
+		}
+
+		this->contextPool.release(ctx);
 	}
 
-	VisitedPtr SequentialIndex::getVisitedSet(const Node& ep) {
-		return std::make_shared<VisitedSet>(this->elemCount, ep.id);
+	Connections* SequentialIndex::getConn() {
+		return &this->conn;
 	}
 
 	void SequentialIndex::writeNeighbors(const uint id, const uint lc, const std::vector<Node>& R) {
-		this->writeNeighbors(id, lc, this->conn.getNeighbors(id, lc), R);
+		auto N = this->conn.getWritableNeighbors(id, lc);
+		N.clear();
+
+		for(const auto& r : R)
+			N.push(r.id);
 	}
 
-	void SequentialIndex::writeNeighbors(
-		const uint id, const uint lc, NeighborsPtr N, const std::vector<Node>& R
-	) {
-		N->clear();
+	void SequentialIndex::writeNeighbors(const uint id, const uint lc, const SearchBuffer& R) {
+		auto N = this->conn.getWritableNeighbors(id, lc);
+		N.clear();
 
-		for(const auto& r : R)
-			N->push(r.id);
+		for(uint i = 0; i < R.len(); i++)
+			N.push(R.get(i).id);
 	}
 
-	void SequentialIndex::writeNeighbors(const uint id, const uint lc, NeighborsPtr N, NearHeap& R) {
-		N->clear();
+	void SequentialIndex::reuseSlots(const ArrayView<const float>& v, const std::vector<uint>& ids) {
+		const auto ctx = this->contextPool.acquire();
+
+		for(size_t i = 0; i < v.getElemCount(); i++)
+			this->reinsert(Element(v.getData(i), ids[i]), *ctx);
 
-		while(R.len())
-			N->push(R.extractTop().id);
+		this->contextPool.release(ctx);
 	}
 
 	std::string SequentialIndex::getString() const {
 		return std::string("SequentialIndex") + AbstractIndex::getString();
 	}
 
-	void SequentialIndex::push(const ArrayView<const float>& v) {
-		for(auto i = this->setupFirstElement(v, this->gen); i < v.getElemCount(); i++) {
-			const auto l = this->gen.getNextLevel();
-			this->insertWithLevel(Element(v.getData(i), this->elemCount), l);
+	QueryResPtr SequentialIndex::queryBatch(
+		const ArrayView<const float>& v, const uint efSearch, const uint k,
+		const std::vector<IDFilter>& filters
+	) {
+		checkFilterCount(filters, v.getElemCount());
+		auto res = std::make_shared<QueryResults>(k, v.getElemCount());
+		const auto ctx = this->contextPool.acquire();
 
-			if(l > this->entryLevel)
-				this->setEntry(this->elemCount, l);
+		if(this->space.normalize) {
+			std::vector<float> normQuery(this->space.dim, 0.f);
 
-			this->elemCount++;
+			for(size_t queryIdx = 0; queryIdx < v.getElemCount(); queryIdx++) {
+				this->space.normalizeData(v.getData(queryIdx), normQuery.data());
+				res->push(
+					this->query(
+						normQuery.data(), efSearch, k, *ctx, getQueryFilter(filters, queryIdx)
+					), queryIdx
+				);
+			}
+		} else {
+			for(size_t queryIdx = 0; queryIdx < v.getElemCount(); queryIdx++) {
+				res->push(
+					this->query(
+						v.getData(queryIdx), efSearch, k, *ctx, getQueryFilter(filters, queryIdx)
+					), queryIdx
+				);
+			}
 		}
+
+		this->contextPool.release(ctx);
+		return res;
 	}
 
-	QueryResPtr SequentialIndex::queryBatch(
-		const ArrayView<const float>& v, const uint efSearch, const uint k
+	RaggedResPtr SequentialIndex::queryBatch(
+		const ArrayView<const float>& v, const std::vector<uint>& efSearch,
+		const std::vector<uint>& k
 	) {
-		auto res = std::make_shared<QueryResults>(k, v.getElemCount());
+		checkQueryParams(efSearch, k, v.getElemCount());
+		auto res = std::make_shared<RaggedResults>(k);
+		const auto ctx = this->contextPool.acquire();
 
 		if(this->space.normalize) {
 			std::vector<float> normQuery(this->space.dim, 0.f);
 
 			for(size_t queryIdx = 0; queryIdx < v.getElemCount(); queryIdx++) {
 				this->space.normalizeData(v.getData(queryIdx), normQuery.data());
-				res->push(this->query(normQuery.data(), efSearch, k), queryIdx);
+				res->push(
+					this->query(normQuery.data(), efSearch[queryIdx], k[queryIdx], *ctx), queryIdx
+				);
 			}
 		} else {
 			for(size_t queryIdx = 0; queryIdx < v.getElemCount(); queryIdx++) {
-				res->push(this->query(v.getData(queryIdx), efSearch, k), queryIdx);
+				const auto q = v.getData(queryIdx);
+				res->push(this->query(q, efSearch[queryIdx], k[queryIdx], *ctx), queryIdx);
 			}
 		}
 
+		this->contextPool.release(ctx);
+		res->trim();
 		return res;
 	}
 
+	RaggedResPtr SequentialIndex::rangeQueryBatch(
+		const ArrayView<const float>& v, const float radius, const uint efSearch
+	) {
+		std::vector<std::vector<Node>> lists(v.getElemCount());
+		const auto ctx = this->contextPool.acquire();
+
+		if(this->space.normalize) {
+			std::vector<float> normQuery(this->space.dim, 0.f);
+
+			for(size_t queryIdx = 0; queryIdx < v.getElemCount(); queryIdx++) {
+				this->space.normalizeData(v.getData(queryIdx), normQuery.data());
+				lists[queryIdx] = this->rangeQuery(normQuery.data(), radius, efSearch, *ctx);
+			}
+		} else {
+			for(size_t queryIdx = 0; queryIdx < v.getElemCount(); queryIdx++)
+				lists[queryIdx] = this->rangeQuery(v.getData(queryIdx), radius, efSearch, *ctx);
+		}
+
+		this->contextPool.release(ctx);
+		return std::make_shared<RaggedResults>(lists);
+	}
+
 	SequentialIndex::SequentialIndex(
 		const IndexConfig& cfg, const size_t dim, const uint levelGenSeed,
 		const SpaceKind spaceKind, const SIMDType simdType
 	) : AbstractIndex(cfg, dim, spaceKind, simdType),
-		conn(this->cfg.maxElemCount, this->cfg.mMax, this->cfg.mMax0),
+		conn(
+			this->cfg.maxElemCount, this->cfg.mMax, this->cfg.mMax0, this->getRecords()
+		),
 		gen(this->cfg.getML(), levelGenSeed) {}
 
+	SequentialIndex::SequentialIndex(
+		const IndexFilePtr& file, const uint levelGenSeed, const SIMDType simdType
+	) : SequentialIndex(
+			getFileConfig(*file), file->getHeader().dim, levelGenSeed,
+			SpaceKind(file->getHeader().spaceKind), simdType
+		) {
+
+		this->load(file);
+	}
+
+	float getRaggedRecall(const RaggedResults& correct, const RaggedResults& found) {
+		size_t hits = 0;
+		std::unordered_set<uint> correctSet;
+
+		// Queries without any neighbor in range count as fully recalled.
+		if(!correct.getTotalCount())
+			return 1.f;
+
+		for(size_t queryIdx = 0; queryIdx < correct.getQueryCount(); queryIdx++) {
+			correctSet.clear();
+
+			for(size_t i = 0; i < correct.getCount(queryIdx); i++)
+				correctSet.insert(correct.getID(queryIdx, i));
+
+			for(size_t i = 0; i < found.getCount(queryIdx); i++)
+				if(correctSet.find(found.getID(queryIdx, i)) != correctSet.end())
+					hits++;
+		}
+
+		return float(hits) / float(correct.getTotalCount());
+	}
+
 	float getRecall(const ArrayView<const uint>& correctIDs, const ArrayView<const uint>& foundIDs) {
 		size_t hits = 0;
 		std::unordered_set<uint> correctSet;
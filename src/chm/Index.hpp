@@ -1,23 +1,39 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <ostream>
 #include <random>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <unordered_set>
 #include <vector>
 #include "DistanceFunction.hpp"
+#include "IndexFile.hpp"
+#include "ThreadPool.hpp"
 
 namespace chm {
+	namespace chr = std::chrono;
 	using uint = unsigned int;
 
 	struct Node {
 		float dist;
 		uint id;
 
+		float getDist() const;
+		uint getID() const;
 		Node();
 		Node(const float dist, const uint id);
+		bool operator<(const Node& o) const;
 	};
 
 	struct FarHeapCmp {
@@ -37,6 +53,7 @@ namespace chm {
 		std::vector<Node> nodes;
 
 	public:
+		void clear();
 		Node extractTop();
 		template<class OtherCmp> Heap(Heap<OtherCmp>& o);
 		Heap() = default;
@@ -51,65 +68,187 @@ namespace chm {
 	using FarHeap = Heap<FarHeapCmp>;
 	using NearHeap = Heap<NearHeapCmp>;
 
-	class NeighborsInterface {
+	// Orders by distance, then by ID, with a single integer comparison.
+	struct PackedNode {
+		uint64_t key;
+
+		float getDist() const;
+		uint getID() const;
+		PackedNode() = default;
+		PackedNode(const float dist, const uint id);
+		bool operator<(const PackedNode& o) const;
+	};
+
+	template<class Entry>
+	class SortedBuffer {
+		uint capacity;
+		uint count;
+		std::vector<Entry> entries;
+		std::vector<uint8_t> expanded;
+		uint nextIdx;
+
 	public:
-		virtual std::vector<uint>::iterator begin() = 0;
-		virtual void clear() = 0;
-		virtual std::vector<uint>::iterator end() = 0;
-		virtual uint len() const = 0;
-		virtual void push(const uint id) = 0;
+		Node extractNext();
+		Node get(const uint i) const;
+		Node getNext() const;
+		bool hasNext() const;
+		uint len() const;
+		bool push(const float dist, const uint id);
+		void remove(const uint id);
+		void reset(const uint capacity);
+		SortedBuffer(const uint capacity);
 	};
 
-	using NeighborsPtr = std::shared_ptr<NeighborsInterface>;
+	using SearchBuffer = SortedBuffer<PackedNode>;
+
+	class NeighborsBuffer {
+		std::vector<uint> candidates;
+		std::vector<float> distances;
+		std::vector<uint> ids;
+
+	public:
+		uint* getCandidates();
+		uint* getData();
+		float* getDistances();
+		NeighborsBuffer(const size_t maxLen);
+	};
 
-	class NeighborsCopy : public NeighborsInterface {
-		std::vector<uint> n;
+	class NeighborsView {
+		const uint* first;
+		uint count;
 
 	public:
-		std::vector<uint>::iterator begin() override;
-		void clear() override;
-		std::vector<uint>::iterator end() override;
-		uint len() const override;
-		NeighborsCopy(const std::vector<uint>::iterator& lenIter);
-		void push(const uint id) override;
+		const uint* begin() const;
+		const uint* end() const;
+		uint len() const;
+		NeighborsView(const uint* const first, const uint count);
 	};
 
-	class NeighborsView : public NeighborsInterface {
-		std::vector<uint>::iterator lenIter;
+	class WritableNeighbors {
+		uint* const lenPtr;
 
 	public:
-		std::vector<uint>::iterator begin() override;
-		void clear() override;
-		std::vector<uint>::iterator end() override;
-		uint len() const override;
-		NeighborsView(const std::vector<uint>::iterator& lenIter);
-		void push(const uint id) override;
+		void clear();
+		void push(const uint id);
+		WritableNeighbors(uint* const lenPtr);
 	};
 
+	// Grows by whole chunks, so stored records never move and readers need no lock.
+	template<class T>
+	class ChunkedArray {
+		// Chunks start on a cache line, so rows with a stride of whole cache lines stay aligned.
+		static constexpr size_t alignment = std::max(alignof(T), size_t(64));
+
+		struct ChunkDeleter {
+			size_t len = 0;
+
+			void operator()(T* const p) const;
+		};
+
+		using Chunk = std::unique_ptr<T[], ChunkDeleter>;
+
+		std::atomic<size_t> capacity;
+		size_t chunkShift;
+		std::vector<Chunk> chunks;
+		std::mutex m;
+		const size_t stride;
+		std::atomic<T**> table;
+		size_t tableLen;
+		std::vector<std::unique_ptr<T*[]>> tables;
+
+		static Chunk allocateChunk(const size_t len);
+		static size_t getChunkShift(const size_t count);
+
+	public:
+		ChunkedArray(const size_t stride, const size_t count);
+		size_t getCapacity() const;
+		T* getData(const size_t i) const;
+		void load(IndexFile& file, const size_t count);
+		void reserve(const size_t count);
+		void save(std::ostream& s, const size_t count) const;
+	};
+
+	struct alignas(64) CacheLine {
+		char bytes[64];
+	};
+
+	// Scratch floats that start on a cache line, like the padded vectors they are compared with.
+	class AlignedFloats {
+		std::vector<CacheLine> lines;
+
+	public:
+		AlignedFloats(const size_t len);
+		float* data();
+	};
+
+	class InterleavedRecords;
+
+	enum class LockMode {
+		MUTEX,
+		SPIN,
+		STRIPED
+	};
+
+	std::string lockModeToStr(const LockMode mode);
+
 	class Connections {
 	protected:
-		std::vector<uint> layer0;
+		const size_t header0;
+		ChunkedArray<uint> layer0;
+		const LockMode lockMode;
 		const size_t maxLen;
 		const size_t maxLen0;
-		std::vector<std::vector<uint>> upperLayers;
-
-	protected:
-		std::vector<uint>::iterator getLenIter(const uint id, const uint lc);
+		ChunkedArray<std::mutex> mutexes;
+		bool optimisticReads;
+		InterleavedRecords* const records;
+		std::vector<std::mutex> stripes;
+		const bool threadSafe;
+		ChunkedArray<std::vector<uint>> upperLayers;
+		ChunkedArray<std::atomic<uint>> versions;
+
+		Connections(
+			const uint maxElemCount, const uint mMax, const uint mMax0, const bool threadSafe,
+			const LockMode lockMode, const size_t stripeCount, InterleavedRecords* const records
+		);
+		uint* getLayer0(const uint id);
+		uint* getLenIter(const uint id, const uint lc);
+		std::atomic<uint>& getSpinLock(const uint id);
+		std::atomic<uint>& getVersion(const uint id);
+		void lock(const uint id);
+		void unlock(const uint id);
 
 	public:
-		Connections(const uint maxElemCount, const uint mMax, const uint mMax0);
-		virtual NeighborsPtr getNeighbors(const uint id, const uint lc);
+		Connections(
+			const uint maxElemCount, const uint mMax, const uint mMax0,
+			InterleavedRecords* const records
+		);
+		void fillHeader(IndexFileHeader& header, const uint count);
+		uint getLevel(const uint id) const;
+		NeighborsView getNeighbors(const uint id, const uint lc, NeighborsBuffer& buf);
+		WritableNeighbors getWritableNeighbors(const uint id, const uint lc);
 		void init(const uint id, const uint level);
+		void load(IndexFile& file, const uint count);
+		void prefetch(const uint id, const uint lc);
+		void reserve(const size_t count);
+		void save(std::ostream& s, const uint count);
 	};
 
 	class ThreadSafeConnections : public Connections {
-		std::vector<std::mutex> mutexes;
-
 	public:
-		std::mutex& getMutex(const uint id);
-		NeighborsPtr getNeighbors(const uint id, const uint lc) override;
-		NeighborsView getWritableNeighbors(const uint id, const uint lc);
-		ThreadSafeConnections(const uint maxElemCount, const uint mMax, const uint mMax0);
+		using Connections::lock;
+		using Connections::unlock;
+
+		void beginWrite(const uint id);
+		void endWrite(const uint id);
+		size_t getLockBytes() const;
+		LockMode getLockMode() const;
+		size_t getStripeCount() const;
+		bool hasOptimisticReads() const;
+		void setOptimisticReads(const bool optimisticReads);
+		ThreadSafeConnections(
+			const uint maxElemCount, const uint mMax, const uint mMax0,
+			const LockMode lockMode, const size_t stripeCount, InterleavedRecords* const records
+		);
 	};
 
 	template<typename T>
@@ -149,58 +288,201 @@ namespace chm {
 
 	std::string spaceKindToStr(const SpaceKind kind);
 
+	enum class VectorStorage {
+		FLOAT,
+		INT8,
+		PQ,
+		FP16,
+		BF16
+	};
+
+	std::string vectorStorageToStr(const VectorStorage storage);
+
 	class Space {
+		const BatchDistanceFunction batchDist;
+		std::vector<float> codebooks;
+		const size_t codeDim;
+		ChunkedArray<uint8_t> codes;
 		const size_t dim16;
 		const size_t dim4;
 		const DistanceInfo distInfo;
-		std::vector<float> elemData;
-		ArrayView<float> view;
-
+		ChunkedArray<float> elemData;
+		const bool keepFloats;
+		const size_t kernelDim;
+		const QuantizedDistanceFunction quantizedDist;
+		const InterleavedRecords* const records;
+		std::vector<float> sqMin;
+		std::vector<float> sqScale;
+		const size_t subspaceCount;
+		const size_t subspaceDim;
+		bool trained;
+
+		void encode(const float* const data, uint8_t* const code) const;
+		void trainCodebooks(const std::vector<float>& samples, const size_t sampleCount);
+		const uint8_t* getCode(const uint id) const;
+		size_t getCodeBytes() const;
+		size_t getCodeLen() const;
 		float getNorm(const float* const data) const;
 
 	public:
 		const size_t dim;
+		const SpaceKind kind;
 		const bool normalize;
+		const bool padded;
+		const VectorStorage storage;
 
+		// Bytes reserved for float rows and codes, vectors in interleaved records are not counted.
+		size_t getAllocatedBytes() const;
+		size_t getCapacity() const;
 		float* getData(const uint id);
 		const float* const getData(const uint id) const;
 		float getDistance(const float* const aData, const float* const bData) const;
-		float getDistance(const float* const aData, const uint bID) const;
-		float getDistance(const uint aID, const float* const bData) const;
-		float getDistance(const uint aID, const uint bID) const;
+		float getDistance(const float* const query, const uint id) const;
 		std::string getDistanceName() const;
+		void getDistances(
+			const float* const query, const uint* const ids, const size_t count, float* const res,
+			const uint prefetchDistance
+		) const;
+		size_t getFloatCapacity() const;
+		size_t getQueryLen() const;
+		const float* getVector(const uint id, float* const buf) const;
+		size_t getVectorBytes() const;
+		bool hasFloats() const;
+		bool isTrained() const;
+		void load(IndexFile& file, const uint count);
 		void normalizeData(const float* const data, float* const res) const;
+		void prefetch(const uint id) const;
+		const float* prepareQuery(const float* const q, float* const buf) const;
 		void push(const Element& e);
+		void reserve(const size_t count);
+		void save(std::ostream& s, const uint count) const;
 		Space(const size_t dim, const SpaceKind kind, const uint maxElemCount, const SIMDType simdType);
+		Space(
+			const size_t dim, const SpaceKind kind, const uint maxElemCount, const SIMDType simdType,
+			const InterleavedRecords* const records,
+			const VectorStorage storage = VectorStorage::FLOAT, const bool keepFloats = false,
+			const size_t subspaceCount = 0, const bool padded = false
+		);
+		void train(const ArrayView<const float>& v);
 	};
 
 	class VisitedSet {
-		std::vector<bool> v;
+		uint16_t epoch;
+		std::vector<uint16_t> marks;
 
 	public:
 		bool isMarked(const uint id) const;
 		void mark(const uint id);
-		VisitedSet(const uint elemCount, const uint epID);
+		void prepare(const uint epID);
+		VisitedSet(const uint elemCount);
+	};
+
+	// Allowed IDs as a bitmap, so a search checks each node it reaches with a single load.
+	class IDFilter {
+		size_t allowedCount;
+		std::vector<uint64_t> words;
+
+	public:
+		void allow(const uint id);
+		uint findNext(const uint id) const;
+		size_t getAllowedCount() const;
+		IDFilter(const size_t elemCount);
+		IDFilter(const size_t elemCount, const std::function<bool(const uint)>& isAllowed);
+		bool isAllowed(const uint id) const;
+	};
+
+	enum class FilterMode {
+		AUTO,
+		BRUTEFORCE,
+		GRAPH
+	};
+
+	std::string filterModeToStr(const FilterMode mode);
+
+	enum class StorageLayout {
+		INTERLEAVED,
+		SPLIT
 	};
 
-	using VisitedPtr = std::shared_ptr<VisitedSet>;
+	std::string storageLayoutToStr(const StorageLayout layout);
 
 	struct IndexConfig {
 		const uint efConstruction;
+		const StorageLayout layout;
 		const uint maxElemCount;
+		const double mL;
 		const uint mMax;
 		const uint mMax0;
+		const bool padded;
+		const uint pqSubspaces;
+		const bool rerank;
+		const VectorStorage storage;
 
 		double getML() const;
-		IndexConfig(const uint efConstruction, const uint mMax, const uint maxElemCount);
+		IndexConfig(
+			const uint efConstruction, const uint mMax, const uint maxElemCount,
+			const StorageLayout layout = StorageLayout::SPLIT, const double mL = 0.0,
+			const VectorStorage storage = VectorStorage::FLOAT, const bool rerank = false,
+			const uint pqSubspaces = 0, const bool padded = false
+		);
+	};
+
+	struct SearchContext {
+		NeighborsBuffer buf;
+		NearHeap candidates;
+		std::vector<float> decoded;
+		std::vector<Node> inRange;
+		SearchBuffer neighbors;
+		std::vector<float> neighborDecoded;
+		AlignedFloats nodeQuery;
+		std::vector<float> normalized;
+		AlignedFloats query;
+		SearchBuffer reranked;
+		SearchBuffer results;
+		VisitedSet visited;
+
+		SearchContext(const IndexConfig& cfg, const Space& space);
+	};
+
+	using ContextPtr = std::shared_ptr<SearchContext>;
+
+	class ContextPool {
+		const IndexConfig& cfg;
+		std::vector<ContextPtr> contexts;
+		std::mutex m;
+		const Space& space;
+
+	public:
+		ContextPtr acquire();
+		void release(const ContextPtr& ctx);
+		ContextPool(const IndexConfig& cfg, const Space& space);
+	};
+
+	class InterleavedRecords {
+		const bool enabled;
+		ChunkedArray<CacheLine> lines;
+		const size_t linksOffset;
+
+	public:
+		size_t getCapacity() const;
+		uint* getLinks(const uint id) const;
+		float* getVector(const uint id) const;
+		InterleavedRecords(const IndexConfig& cfg, const size_t dim);
+		bool isEnabled() const;
+		void load(IndexFile& file, const uint count);
+		void reserve(const size_t count);
+		void save(std::ostream& s, const uint count) const;
 	};
 
+	// A query that finds fewer than k neighbors is padded with missingID at an infinite distance.
 	class QueryResults {
 		ArrayView<float> distances;
 		ArrayView<uint> ids;
 		bool owningData;
 
 	public:
+		static constexpr uint missingID = std::numeric_limits<uint>::max();
+
 		~QueryResults();
 		void copyIDsTo(std::vector<uint>& v) const;
 		float getDistance(const size_t queryIdx, const size_t neighborIdx);
@@ -208,13 +490,64 @@ namespace chm {
 		const ArrayView<const uint> getIDs() const;
 		size_t getK() const;
 		size_t getQueryCount() const;
-		void push(FarHeap& h, const size_t queryIdx);
+		void push(const SearchBuffer& W, const size_t queryIdx);
 		QueryResults(const size_t k, const size_t queryCount);
 		void set(const size_t queryIdx, const size_t neighborIdx, const float dist, const uint id);
 	};
 
 	using QueryResPtr = std::shared_ptr<QueryResults>;
 
+	// Lists of any length stored back to back, query i owns entries offsets[i] to offsets[i + 1].
+	class RaggedResults {
+		std::vector<uint> counts;
+		std::vector<float> distances;
+		std::vector<uint> ids;
+		std::vector<size_t> offsets;
+
+	public:
+		size_t getCount(const size_t queryIdx) const;
+		float getDistance(const size_t queryIdx, const size_t neighborIdx) const;
+		uint getID(const size_t queryIdx, const size_t neighborIdx) const;
+		const std::vector<uint>& getIDs() const;
+		const std::vector<size_t>& getOffsets() const;
+		size_t getQueryCount() const;
+		size_t getTotalCount() const;
+		void push(const SearchBuffer& W, const size_t queryIdx);
+		RaggedResults(const std::vector<std::vector<Node>>& lists);
+		RaggedResults(const std::vector<uint>& capacities);
+		void trim();
+	};
+
+	using RaggedResPtr = std::shared_ptr<RaggedResults>;
+
+	// Zero leaves a limit off. Patience is the number of expansions the top k may stay unchanged.
+	struct SearchBudget {
+		uint maxDistances;
+		uint maxHops;
+		uint patience;
+		chr::nanoseconds timeLimit;
+
+		bool isLimited() const;
+		SearchBudget(
+			const uint maxDistances = 0, const uint maxHops = 0,
+			const chr::nanoseconds timeLimit = chr::nanoseconds(0), const uint patience = 0
+		);
+	};
+
+	class BudgetTracker {
+		const SearchBudget& budget;
+		chr::steady_clock::time_point deadline;
+		uint distances;
+		uint hops;
+		const uint k;
+		float kthDist;
+		uint stableHops;
+
+	public:
+		BudgetTracker(const SearchBudget& budget, const uint k);
+		bool expand(const uint distanceCount, const SearchBuffer& W);
+	};
+
 	class LevelGenerator {
 		std::uniform_real_distribution<double> dist;
 		std::default_random_engine gen;
@@ -225,152 +558,309 @@ namespace chm {
 		LevelGenerator(const double mL, const uint seed);
 	};
 
+	// Deleted nodes keep their links, so searches still pass through them.
+	enum class Tombstone : uint8_t {
+		LIVE,
+		DELETED,
+		REUSED
+	};
+
 	class AbstractIndex {
-		NearHeap getNearHeap(NeighborsPtr n, const float* const q);
-		Node processLowerLayer(const Node& ep, const uint lc, const Element& q);
-		FarHeap searchLowerLayer(
-			const uint ef, const Node& ep, const uint lc, const float* const q, const bool s
+		std::vector<uint> claimDeletedSlots(const size_t count);
+		void getNearest(const NeighborsView& N, const float* const query, SearchContext& ctx);
+		uint linkElement(const Element& q, const uint l, SearchContext& ctx, const uint lMin);
+		std::shared_lock<std::shared_mutex> lockVectors();
+		Node processLowerLayer(
+			const Node& ep, const uint lc, const Element& q, const float* const query,
+			SearchContext& ctx
+		);
+		void repairNeighbors(const uint id, const uint lc, SearchContext& ctx);
+		const SearchBuffer& rerank(const float* const q, SearchContext& ctx);
+		void scanAllowed(
+			const uint ef, const float* const q, const IDFilter& filter, SearchContext& ctx
+		);
+		void searchLowerLayer(
+			const uint ef, const Node& ep, const uint lc, const float* const q, SearchContext& ctx,
+			BudgetTracker* const tracker = nullptr
+		);
+		void searchLowerLayerFiltered(
+			const uint ef, const Node& ep, const float* const q, const IDFilter* const filter,
+			SearchContext& ctx, BudgetTracker* const tracker
+		);
+		void searchLowerLayerRange(
+			const float radius, const uint ef, const Node& ep, const float* const q,
+			SearchContext& ctx
+		);
+		Node searchUpperLayer(
+			const Node& ep, const uint lc, const float* const q, NeighborsBuffer& buf
 		);
-		Node searchUpperLayer(const Node& ep, const uint lc, const float* const q);
-		std::vector<Node> selectNeighbors(const uint M, const float* const q, NearHeap& W);
+		Node searchUpperLayers(const float* const q, NeighborsBuffer& buf);
+		std::vector<Node> selectNeighbors(const uint M, const SearchBuffer& W, SearchContext& ctx);
 
 	protected:
-		uint elemCount;
-		uint entryID;
-		uint entryLevel;
-
+		std::mutex appendMutex;
+		std::atomic<uint> deletedCount;
+		std::atomic<uint> elemCount;
+		std::atomic<uint64_t> entry;
+		IndexFilePtr file;
+		FilterMode filterMode;
+		std::vector<uint> freeSlots;
+		std::mutex freeSlotsMutex;
+		uint prefetchDistance;
+		// Set while reused slots are relinked, their vectors are new but their links are not yet.
+		std::atomic<bool> reusing;
+		SearchBudget searchBudget;
+		ChunkedArray<std::atomic<Tombstone>> tombstones;
+		// Searches share it while elements are deleted, overwriting reused vectors takes it
+		// exclusively.
+		std::shared_mutex vectorsMutex;
+
+		virtual void append(const ArrayView<const float>& v) = 0;
 		virtual Connections* getConn() = 0;
-		virtual VisitedPtr getVisitedSet(const Node& ep) = 0;
+		InterleavedRecords* getRecords();
+		void load(const IndexFilePtr& file);
+		void prepareStorage(const ArrayView<const float>& v);
+		virtual void reuseSlots(const ArrayView<const float>& v, const std::vector<uint>& ids) = 0;
 		size_t setupFirstElement(const ArrayView<const float>& v, LevelGenerator& gen);
 		virtual void writeNeighbors(const uint id, const uint lc, const std::vector<Node>& R) = 0;
-		virtual void writeNeighbors(
-			const uint id, const uint lc, NeighborsPtr N, const std::vector<Node>& R
-		) = 0;
-		virtual void writeNeighbors(const uint id, const uint lc, NeighborsPtr N, NearHeap& R) = 0;
+		virtual void writeNeighbors(const uint id, const uint lc, const SearchBuffer& R) = 0;
 
 	public:
 		IndexConfig cfg;
+		InterleavedRecords records;
 		Space space;
+		ContextPool contextPool;
 
 		AbstractIndex(
 			IndexConfig cfg, const size_t dim, const SpaceKind spaceKind, const SIMDType simdType
 		);
+		size_t getCapacity() const;
+		uint getDeletedCount() const;
+		uint getEntryID() const;
 		uint getEntryLevel() const;
 		virtual std::string getString() const;
-		void insertWithLevel(const Element& q, const uint l);
-		void setEntry(const uint id, const uint level);
-		virtual void push(const ArrayView<const float>& v) = 0;
-		FarHeap query(const float* const q, const uint efSearch, const uint k);
+		// Fills deleted slots first and appends the rest, returning the ID each vector got.
+		std::vector<uint> insert(const ArrayView<const float>& v);
+		// Returns the entry level the element was linked below.
+		uint insertWithLevel(const Element& q, const uint l, SearchContext& ctx);
+		bool isDeleted(const uint id) const;
+		bool isReused(const uint id) const;
+		void markDeleted(const uint id);
+		bool promoteEntry(const uint id, const uint level);
+		void setFilterMode(const FilterMode mode);
+		void setPrefetchDistance(const uint d);
+		void setSearchBudget(const SearchBudget& budget);
+		// Appends and slot reuse run one at a time, searches may run alongside either.
+		void push(const ArrayView<const float>& v);
+		const SearchBuffer& query(
+			const float* const q, const uint efSearch, const uint k, SearchContext& ctx,
+			const IDFilter* const filter = nullptr
+		);
+		// Filters hold either one allow-list shared by every query or one list per query.
 		virtual QueryResPtr queryBatch(
-			const ArrayView<const float>& v, const uint efSearch, const uint k
+			const ArrayView<const float>& v, const uint efSearch, const uint k,
+			const std::vector<IDFilter>& filters = {}
+		) = 0;
+		// Every query has its own efSearch and k, results are stored back to back.
+		virtual RaggedResPtr queryBatch(
+			const ArrayView<const float>& v, const std::vector<uint>& efSearch,
+			const std::vector<uint>& k
 		) = 0;
+		// Radius is compared with the distances the space reports, squared for Euclidean.
+		const std::vector<Node>& rangeQuery(
+			const float* const q, const float radius, const uint efSearch, SearchContext& ctx
+		);
+		virtual RaggedResPtr rangeQueryBatch(
+			const ArrayView<const float>& v, const float radius, const uint efSearch
+		) = 0;
+		void reinsert(const Element& q, SearchContext& ctx);
+		// Links the layers above L that a lost entry promotion left without neighbors.
+		void relinkUpperLayers(const Element& q, const uint L, const uint l, SearchContext& ctx);
+		void reserve(const size_t count);
+		void save(const std::string& path);
+		void unmarkDeleted(const uint id);
 	};
 
 	using IndexPtr = std::shared_ptr<AbstractIndex>;
 
+	enum class ChunkPolicy {
+		FIXED,
+		GUIDED
+	};
+
+	std::string chunkPolicyToStr(const ChunkPolicy policy);
+
 	class ThreadSafeFloatView {
-		size_t currID;
+		const size_t chunkSize;
+		std::atomic<size_t> currID;
+		const uint* const ids;
 		uint idOffset;
-		std::mutex m;
+		const ChunkPolicy policy;
 		const ArrayView<const float> v;
+		const size_t workersNum;
 
 	public:
-		Element getNextElement();
-		ThreadSafeFloatView(const uint idOffset, const ArrayView<const float>& v);
+		Element getElement(const size_t i) const;
+		bool getNextChunk(size_t& first, size_t& last);
+		ThreadSafeFloatView(
+			const uint idOffset, const ArrayView<const float>& v, const size_t firstID,
+			const ChunkPolicy policy, const size_t chunkSize, const size_t workersNum,
+			const uint* const ids = nullptr
+		);
 	};
 
 	class ParallelIndex : public AbstractIndex {
+		ChunkPolicy chunkPolicy;
+		size_t chunkSize;
 		ThreadSafeConnections conn;
-		std::mutex entryPointMutex;
 		uint levelGenSeed;
-		size_t workersNum;
+		ThreadPoolPtr pool;
 
+		void append(const ArrayView<const float>& v) override;
 		Connections* getConn() override;
-		VisitedPtr getVisitedSet(const Node& ep) override;
+		void reuseSlots(const ArrayView<const float>& v, const std::vector<uint>& ids) override;
 		void writeNeighbors(const uint id, const uint lc, const std::vector<Node>& R) override;
-		void writeNeighbors(
-			const uint id, const uint lc, NeighborsPtr, const std::vector<Node>& R
-		) override;
-		void writeNeighbors(const uint id, const uint lc, NeighborsPtr, NearHeap& R) override;
+		void writeNeighbors(const uint id, const uint lc, const SearchBuffer& R) override;
 
 	public:
-		std::mutex& getEntryPointMutex();
+		size_t getLockBytes() const;
 		std::string getString() const override;
 		ParallelIndex(
 			const IndexConfig& cfg, const size_t dim, const uint levelGenSeed,
-			const SpaceKind spaceKind, const SIMDType simdType
+			const SpaceKind spaceKind, const SIMDType simdType,
+			const LockMode lockMode = LockMode::MUTEX, const size_t stripeCount = 0
 		);
-		void push(const ArrayView<const float>& v) override;
-		QueryResPtr queryBatch(const ArrayView<const float>& v, const uint efSearch, const uint k) override;
+		ParallelIndex(
+			const IndexFilePtr& file, const uint levelGenSeed, const SIMDType simdType,
+			const LockMode lockMode = LockMode::MUTEX, const size_t stripeCount = 0
+		);
+		QueryResPtr queryBatch(
+			const ArrayView<const float>& v, const uint efSearch, const uint k,
+			const std::vector<IDFilter>& filters = {}
+		) override;
+		RaggedResPtr queryBatch(
+			const ArrayView<const float>& v, const std::vector<uint>& efSearch,
+			const std::vector<uint>& k
+		) override;
+		RaggedResPtr rangeQueryBatch(
+			const ArrayView<const float>& v, const float radius, const uint efSearch
+		) override;
+		void setChunkPolicy(const ChunkPolicy policy, const size_t chunkSize);
+		void setOptimisticReads(const bool optimisticReads);
+		void setThreadPool(const ThreadPoolPtr& pool);
 		void setWorkersNum(const size_t n);
 	};
 
 	class ParallelWorker {
-		std::thread t;
+		size_t chunkEnd;
+		ThreadSafeFloatView* const elemView;
+		size_t nextIdx;
 
 	protected:
-		ThreadSafeFloatView* const elemView;
 		ParallelIndex* const index;
 
-		virtual void run() = 0;
+		Element getNextElement();
 
 	public:
-		void join();
 		ParallelWorker(ParallelIndex* const index, ThreadSafeFloatView* const elemView);
-		void start();
+		virtual void run() = 0;
 	};
 
 	class ParallelInsertWorker : public ParallelWorker {
 		const uint levelGenSeed;
 
-	protected:
-		void run() override;
-
 	public:
 		ParallelInsertWorker(
 			ParallelIndex* const index, ThreadSafeFloatView* const elemView, const uint levelGenSeed
 		);
+		void run() override;
+	};
+
+	class ParallelReinsertWorker : public ParallelWorker {
+	public:
+		ParallelReinsertWorker(ParallelIndex* const index, ThreadSafeFloatView* const elemView);
+		void run() override;
 	};
 
 	class ParallelQueryWorker : public ParallelWorker {
 		const uint efSearch;
+		const std::vector<IDFilter>& filters;
 		const uint k;
 		const QueryResPtr res;
 
-	protected:
+	public:
+		ParallelQueryWorker(
+			ParallelIndex* const index, ThreadSafeFloatView* const elemView,
+			const uint efSearch, const uint k, const QueryResPtr res,
+			const std::vector<IDFilter>& filters
+		);
 		void run() override;
+	};
+
+	class ParallelRaggedQueryWorker : public ParallelWorker {
+		const std::vector<uint>& efSearch;
+		const std::vector<uint>& k;
+		const RaggedResPtr res;
 
 	public:
-		ParallelQueryWorker(
+		ParallelRaggedQueryWorker(
 			ParallelIndex* const index, ThreadSafeFloatView* const elemView,
-			const uint efSearch, const uint k, const QueryResPtr res
+			const std::vector<uint>& efSearch, const std::vector<uint>& k, const RaggedResPtr res
+		);
+		void run() override;
+	};
+
+	class ParallelRangeWorker : public ParallelWorker {
+		const uint efSearch;
+		std::vector<std::vector<Node>>& lists;
+		const float radius;
+
+	public:
+		ParallelRangeWorker(
+			ParallelIndex* const index, ThreadSafeFloatView* const elemView, const float radius,
+			const uint efSearch, std::vector<std::vector<Node>>& lists
 		);
+		void run() override;
 	};
 
 	class SequentialIndex : public AbstractIndex {
 		Connections conn;
 		LevelGenerator gen;
 
+		void append(const ArrayView<const float>& v) override;
 		Connections* getConn() override;
-		VisitedPtr getVisitedSet(const Node& ep) override;
+		void reuseSlots(const ArrayView<const float>& v, const std::vector<uint>& ids) override;
 		void writeNeighbors(const uint id, const uint lc, const std::vector<Node>& R) override;
-		void writeNeighbors(
-			const uint id, const uint lc, NeighborsPtr N, const std::vector<Node>& R
-		) override;
-		void writeNeighbors(const uint id, const uint lc, NeighborsPtr N, NearHeap& R) override;
+		void writeNeighbors(const uint id, const uint lc, const SearchBuffer& R) override;
 
 	public:
 		std::string getString() const override;
-		void push(const ArrayView<const float>& v) override;
-		QueryResPtr queryBatch(const ArrayView<const float>& v, const uint efSearch, const uint k) override;
+		QueryResPtr queryBatch(
+			const ArrayView<const float>& v, const uint efSearch, const uint k,
+			const std::vector<IDFilter>& filters = {}
+		) override;
+		RaggedResPtr queryBatch(
+			const ArrayView<const float>& v, const std::vector<uint>& efSearch,
+			const std::vector<uint>& k
+		) override;
+		RaggedResPtr rangeQueryBatch(
+			const ArrayView<const float>& v, const float radius, const uint efSearch
+		) override;
 		SequentialIndex(
 			const IndexConfig& cfg, const size_t dim, const uint levelGenSeed,
 			const SpaceKind spaceKind, const SIMDType simdType
 		);
+		SequentialIndex(const IndexFilePtr& file, const uint levelGenSeed, const SIMDType simdType);
 	};
 
+	float getRaggedRecall(const RaggedResults& correct, const RaggedResults& found);
 	float getRecall(const ArrayView<const uint>& correctIDs, const ArrayView<const uint>& foundIDs);
 
+	template<class Cmp>
+	inline void Heap<Cmp>::clear() {
+		this->nodes.clear();
+	}
+
 	template<class Cmp>
 	inline Node Heap<Cmp>::extractTop() {
 		auto res = this->top();
@@ -419,6 +909,303 @@ namespace chm {
 		return this->nodes.front();
 	}
 
+	inline float Node::getDist() const {
+		return this->dist;
+	}
+
+	inline uint Node::getID() const {
+		return this->id;
+	}
+
+	inline bool Node::operator<(const Node& o) const {
+		return this->dist < o.dist || (this->dist == o.dist && this->id < o.id);
+	}
+
+	inline float PackedNode::getDist() const {
+		auto bits = uint32_t(this->key >> 32);
+		bits ^= uint32_t(int32_t(~bits) >> 31) | 0x80000000u;
+		float res;
+		std::memcpy(&res, &bits, sizeof(res));
+		return res;
+	}
+
+	inline uint PackedNode::getID() const {
+		return uint(this->key);
+	}
+
+	inline PackedNode::PackedNode(const float dist, const uint id) {
+		// Flipping the sign bit of positive floats and all bits of negative ones
+		// makes the bit patterns sort like the values.
+		uint32_t bits;
+		std::memcpy(&bits, &dist, sizeof(bits));
+		bits ^= uint32_t(int32_t(bits) >> 31) | 0x80000000u;
+		this->key = uint64_t(bits) << 32 | id;
+	}
+
+	inline bool PackedNode::operator<(const PackedNode& o) const {
+		return this->key < o.key;
+	}
+
+	template<class Entry>
+	inline Node SortedBuffer<Entry>::extractNext() {
+		const auto i = this->nextIdx;
+		this->expanded[i] = 1;
+
+		do
+			this->nextIdx++;
+		while(this->nextIdx < this->count && this->expanded[this->nextIdx]);
+
+		return this->get(i);
+	}
+
+	template<class Entry>
+	inline Node SortedBuffer<Entry>::get(const uint i) const {
+		const auto& e = this->entries[i];
+		return Node(e.getDist(), e.getID());
+	}
+
+	template<class Entry>
+	inline Node SortedBuffer<Entry>::getNext() const {
+		return this->get(this->nextIdx);
+	}
+
+	template<class Entry>
+	inline bool SortedBuffer<Entry>::hasNext() const {
+		return this->nextIdx < this->count;
+	}
+
+	template<class Entry>
+	inline uint SortedBuffer<Entry>::len() const {
+		return this->count;
+	}
+
+	template<class Entry>
+	inline bool SortedBuffer<Entry>::push(const float dist, const uint id) {
+		const Entry e(dist, id);
+
+		if(this->count == this->capacity && !(e < this->entries[this->count - 1]))
+			return false;
+
+		const auto first = this->entries.data();
+		const auto pos = uint(std::upper_bound(first, first + this->count, e) - first);
+		const auto end = std::min(this->count, this->capacity - 1);
+		std::copy_backward(first + pos, first + end, first + end + 1);
+
+		const auto flags = this->expanded.data();
+		std::copy_backward(flags + pos, flags + end, flags + end + 1);
+
+		first[pos] = e;
+		flags[pos] = 0;
+
+		if(this->count < this->capacity)
+			this->count++;
+		if(pos < this->nextIdx)
+			this->nextIdx = pos;
+
+		return true;
+	}
+
+	template<class Entry>
+	inline void SortedBuffer<Entry>::remove(const uint id) {
+		uint i = 0;
+
+		while(i < this->count && this->entries[i].getID() != id)
+			i++;
+
+		if(i == this->count)
+			return;
+
+		std::copy(
+			this->entries.begin() + i + 1, this->entries.begin() + this->count,
+			this->entries.begin() + i
+		);
+		std::copy(
+			this->expanded.begin() + i + 1, this->expanded.begin() + this->count,
+			this->expanded.begin() + i
+		);
+		this->count--;
+
+		if(i < this->nextIdx)
+			this->nextIdx--;
+	}
+
+	template<class Entry>
+	inline void SortedBuffer<Entry>::reset(const uint capacity) {
+		if(capacity > this->entries.size()) {
+			this->entries.resize(capacity);
+			this->expanded.resize(capacity);
+		}
+
+		this->capacity = capacity;
+		this->count = 0;
+		this->nextIdx = 0;
+	}
+
+	template<class Entry>
+	inline SortedBuffer<Entry>::SortedBuffer(const uint capacity)
+		: capacity(capacity), count(0), entries(capacity), expanded(capacity, 0), nextIdx(0) {}
+
+	template<class T>
+	inline void ChunkedArray<T>::ChunkDeleter::operator()(T* const p) const {
+		std::destroy_n(p, this->len);
+		::operator delete[](p, std::align_val_t(ChunkedArray<T>::alignment));
+	}
+
+	template<class T>
+	inline typename ChunkedArray<T>::Chunk ChunkedArray<T>::allocateChunk(const size_t len) {
+		const auto p = static_cast<T*>(
+			::operator new[](len * sizeof(T), std::align_val_t(ChunkedArray<T>::alignment))
+		);
+		std::uninitialized_value_construct_n(p, len);
+		return Chunk(p, ChunkDeleter{len});
+	}
+
+	template<class T>
+	inline size_t ChunkedArray<T>::getChunkShift(const size_t count) {
+		// The first reservation picks chunks between 1K and 64K records.
+		size_t shift = 10;
+
+		while(shift < 16 && (size_t(1) << shift) < count)
+			shift++;
+
+		return shift;
+	}
+
+	template<class T>
+	inline ChunkedArray<T>::ChunkedArray(const size_t stride, const size_t count)
+		: capacity(0), chunkShift(0), stride(stride), table(nullptr), tableLen(0) {
+
+		this->reserve(count);
+	}
+
+	template<class T>
+	inline size_t ChunkedArray<T>::getCapacity() const {
+		return this->capacity.load(std::memory_order_acquire);
+	}
+
+	template<class T>
+	inline T* ChunkedArray<T>::getData(const size_t i) const {
+		const auto chunk = this->table.load(std::memory_order_acquire)[i >> this->chunkShift];
+		return chunk + (i & ((size_t(1) << this->chunkShift) - 1)) * this->stride;
+	}
+
+	template<class T>
+	inline void ChunkedArray<T>::load(IndexFile& file, const size_t count) {
+		if(!file.isMapped()) {
+			this->reserve(count);
+			const auto chunkLen = size_t(1) << this->chunkShift;
+
+			for(size_t i = 0; i < count; i += chunkLen)
+				file.read(this->getData(i), std::min(chunkLen, count - i) * this->stride * sizeof(T));
+
+			file.endSection();
+			return;
+		}
+
+		if(!this->chunks.empty())
+			throw std::runtime_error("Only empty storage can be mapped.");
+
+		const auto data = static_cast<const T*>(file.map(count * this->stride * sizeof(T)));
+		file.endSection();
+
+		if(!count)
+			return;
+
+		std::unique_lock<std::mutex> lock(this->m);
+		this->chunkShift = ChunkedArray<T>::getChunkShift(count);
+		const auto chunkLen = size_t(1) << this->chunkShift;
+		const auto chunkCount = (count + chunkLen - 1) >> this->chunkShift;
+		auto newTable = std::make_unique<T*[]>(chunkCount);
+
+		// Mapped chunks have no owner and stay read-only.
+		for(size_t i = 0; i < chunkCount; i++) {
+			newTable[i] = const_cast<T*>(data) + i * chunkLen * this->stride;
+			this->chunks.emplace_back(nullptr);
+		}
+
+		this->tableLen = chunkCount;
+		this->table.store(newTable.get(), std::memory_order_release);
+		this->tables.push_back(std::move(newTable));
+		this->capacity.store(count, std::memory_order_release);
+	}
+
+	template<class T>
+	inline void ChunkedArray<T>::reserve(const size_t count) {
+		if(count <= this->getCapacity())
+			return;
+
+		std::unique_lock<std::mutex> lock(this->m);
+
+		if(!this->chunks.empty() && !this->chunks.back())
+			throw std::runtime_error("Mapped storage can't grow.");
+		if(this->chunks.empty())
+			this->chunkShift = ChunkedArray<T>::getChunkShift(count);
+
+		const auto chunkLen = size_t(1) << this->chunkShift;
+		const auto chunkCount = (count + chunkLen - 1) >> this->chunkShift;
+
+		if(chunkCount <= this->chunks.size())
+			return;
+
+		// Readers may still hold the old table, so it is retired instead of freed.
+		if(chunkCount > this->tableLen) {
+			const auto len = std::max(chunkCount, this->tableLen * 2);
+			const auto oldTable = this->table.load(std::memory_order_relaxed);
+			auto newTable = std::make_unique<T*[]>(len);
+			std::copy(oldTable, oldTable + this->chunks.size(), newTable.get());
+			this->tableLen = len;
+			this->tables.push_back(std::move(newTable));
+		}
+
+		const auto t = this->tables.back().get();
+
+		while(this->chunks.size() < chunkCount) {
+			this->chunks.push_back(ChunkedArray<T>::allocateChunk(chunkLen * this->stride));
+			t[this->chunks.size() - 1] = this->chunks.back().get();
+		}
+
+		this->table.store(t, std::memory_order_release);
+		this->capacity.store(chunkCount << this->chunkShift, std::memory_order_release);
+	}
+
+	template<class T>
+	inline void ChunkedArray<T>::save(std::ostream& s, const size_t count) const {
+		const auto chunkLen = size_t(1) << this->chunkShift;
+
+		for(size_t i = 0; i < count; i += chunkLen)
+			s.write(
+				reinterpret_cast<const char*>(this->getData(i)),
+				std::streamsize(std::min(chunkLen, count - i) * this->stride * sizeof(T))
+			);
+
+		IndexFile::writePadding(s, count * this->stride * sizeof(T));
+	}
+
+	inline uint* InterleavedRecords::getLinks(const uint id) const {
+		return reinterpret_cast<uint*>(
+			reinterpret_cast<char*>(this->lines.getData(id)) + this->linksOffset
+		);
+	}
+
+	inline float* InterleavedRecords::getVector(const uint id) const {
+		return reinterpret_cast<float*>(this->lines.getData(id));
+	}
+
+	inline const uint* NeighborsView::begin() const {
+		return this->first;
+	}
+
+	inline const uint* NeighborsView::end() const {
+		return this->first + this->count;
+	}
+
+	inline uint NeighborsView::len() const {
+		return this->count;
+	}
+
+	inline NeighborsView::NeighborsView(const uint* const first, const uint count)
+		: first(first), count(count) {}
+
 	template<typename T>
 	inline ArrayView<T>::ArrayView(T* data, const size_t dim, const size_t elemCount)
 		: data(data), dim(dim), elemCount(elemCount) {}
@@ -0,0 +1,178 @@
+#include <cstring>
+#include <stdexcept>
+#include "IndexFile.hpp"
+
+#if defined(_WIN32)
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace chm {
+	IndexFileHeader::IndexFileHeader()
+		: version(IndexFileHeader::currentVersion), dim(0), efConstruction(0), mMax(0),
+		maxElemCount(0), layout(0), spaceKind(0), elemCount(0), header0(0), storage(0), rerank(0),
+		pqSubspaces(0), padded(0), deletedCount(0), entry(0),
+		mL(0.0), upperLinksCount(0) {
+
+		std::memcpy(this->magic, IndexFileHeader::expectedMagic, sizeof(this->magic));
+	}
+
+	std::string loadModeToStr(const LoadMode mode) {
+		switch(mode) {
+			case LoadMode::COPY:
+				return "copy";
+			case LoadMode::MAP:
+				return "map";
+			default:
+				throw std::runtime_error("Invalid load mode.");
+		}
+		return "";
+	}
+
+	void IndexFile::unmap() {
+		if(!this->data)
+			return;
+
+		#if defined(_WIN32)
+			UnmapViewOfFile(this->data);
+			CloseHandle(this->mapHandle);
+		#else
+			munmap(const_cast<char*>(this->data), this->size);
+		#endif
+
+		this->data = nullptr;
+	}
+
+	void IndexFile::writeHeader(std::ostream& s, const IndexFileHeader& header) {
+		s.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		IndexFile::writePadding(s, sizeof(header));
+	}
+
+	void IndexFile::writePadding(std::ostream& s, const size_t sectionBytes) {
+		// Every section starts on a cache line, so mapped vectors and records stay aligned.
+		constexpr auto alignment = IndexFile::sectionAlignment;
+		static const char zeros[alignment] = {};
+		s.write(zeros, std::streamsize((alignment - sectionBytes % alignment) % alignment));
+	}
+
+	IndexFile::~IndexFile() {
+		this->unmap();
+	}
+
+	void IndexFile::endSection() {
+		const auto padding = (sectionAlignment - this->offset % sectionAlignment) % sectionAlignment;
+
+		if(!this->data)
+			this->stream.ignore(std::streamsize(padding));
+
+		this->offset += padding;
+	}
+
+	const IndexFileHeader& IndexFile::getHeader() const {
+		return this->header;
+	}
+
+	IndexFile::IndexFile(const std::string& path, const LoadMode mode)
+		: data(nullptr), mapHandle(nullptr), offset(0), size(0),
+		stream(path, std::ios::binary) {
+
+		if(!this->stream)
+			throw std::runtime_error("Could not open index file " + path + '.');
+
+		this->read(&this->header, sizeof(this->header));
+		this->endSection();
+
+		if(std::memcmp(this->header.magic, IndexFileHeader::expectedMagic, sizeof(this->header.magic)))
+			throw std::runtime_error("File " + path + " is not an index file.");
+		if(this->header.version != IndexFileHeader::currentVersion)
+			throw std::runtime_error(
+				"Unsupported index file version " + std::to_string(this->header.version) + '.'
+			);
+
+		if(mode == LoadMode::COPY)
+			return;
+
+		this->stream.close();
+
+		#if defined(_WIN32)
+			const auto file = CreateFileA(
+				path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL, nullptr
+			);
+
+			if(file == INVALID_HANDLE_VALUE)
+				throw std::runtime_error("Could not open index file " + path + '.');
+
+			LARGE_INTEGER fileSize;
+			GetFileSizeEx(file, &fileSize);
+			this->size = size_t(fileSize.QuadPart);
+			this->mapHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+
+			if(this->mapHandle)
+				this->data = static_cast<const char*>(
+					MapViewOfFile(this->mapHandle, FILE_MAP_READ, 0, 0, 0)
+				);
+
+			if(!this->data) {
+				if(this->mapHandle)
+					CloseHandle(this->mapHandle);
+				throw std::runtime_error("Could not map index file " + path + '.');
+			}
+		#else
+			const auto fd = open(path.c_str(), O_RDONLY);
+			struct stat st;
+
+			if(fd < 0 || fstat(fd, &st)) {
+				if(fd >= 0)
+					close(fd);
+				throw std::runtime_error("Could not open index file " + path + '.');
+			}
+
+			this->size = size_t(st.st_size);
+			const auto p = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+
+			if(p == MAP_FAILED)
+				throw std::runtime_error("Could not map index file " + path + '.');
+
+			this->data = static_cast<const char*>(p);
+		#endif
+	}
+
+	bool IndexFile::isMapped() const {
+		return this->data != nullptr;
+	}
+
+	const void* IndexFile::map(const size_t bytes) {
+		if(!this->data)
+			throw std::runtime_error("Index file is not mapped.");
+		if(this->offset + bytes > this->size)
+			throw std::runtime_error("Index file is truncated.");
+
+		const auto res = this->data + this->offset;
+		this->offset += bytes;
+		return res;
+	}
+
+	void IndexFile::read(void* const dst, const size_t bytes) {
+		// Level-0 elements have no upper layers, so their destination may be null.
+		if(!bytes)
+			return;
+
+		if(this->data) {
+			std::memcpy(dst, this->map(bytes), bytes);
+			return;
+		}
+
+		if(!this->stream.read(static_cast<char*>(dst), std::streamsize(bytes)))
+			throw std::runtime_error("Index file is truncated.");
+
+		this->offset += bytes;
+	}
+}
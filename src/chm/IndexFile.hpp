@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace chm {
+	struct IndexFileHeader {
+		static constexpr uint32_t currentVersion = 5;
+		static constexpr char expectedMagic[8] = {'C', 'H', 'M', 'H', 'N', 'S', 'W', '\0'};
+
+		char magic[8];
+		uint32_t version;
+		uint32_t dim;
+		uint32_t efConstruction;
+		uint32_t mMax;
+		uint32_t maxElemCount;
+		uint32_t layout;
+		uint32_t spaceKind;
+		uint32_t elemCount;
+		uint32_t header0;
+		uint32_t storage;
+		uint32_t rerank;
+		uint32_t pqSubspaces;
+		uint32_t padded;
+		uint32_t deletedCount;
+		uint64_t entry;
+		double mL;
+		uint64_t upperLinksCount;
+
+		IndexFileHeader();
+	};
+
+	enum class LoadMode {
+		COPY,
+		MAP
+	};
+
+	std::string loadModeToStr(const LoadMode mode);
+
+	class IndexFile {
+		const char* data;
+		IndexFileHeader header;
+		void* mapHandle;
+		size_t offset;
+		size_t size;
+		std::ifstream stream;
+
+		void unmap();
+
+	public:
+		static constexpr size_t sectionAlignment = 64;
+
+		static void writeHeader(std::ostream& s, const IndexFileHeader& header);
+		static void writePadding(std::ostream& s, const size_t sectionBytes);
+
+		~IndexFile();
+		void endSection();
+		const IndexFileHeader& getHeader() const;
+		IndexFile(const std::string& path, const LoadMode mode);
+		bool isMapped() const;
+		const void* map(const size_t bytes);
+		void read(void* const dst, const size_t bytes);
+	};
+
+	using IndexFilePtr = std::shared_ptr<IndexFile>;
+}
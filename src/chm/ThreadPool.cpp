@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <stdexcept>
+#include "ThreadPool.hpp"
+
+#if defined(_WIN32)
+	#define NOMINMAX
+	#include <windows.h>
+#elif defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+namespace chm {
+	void ThreadPool::Batch::finish(const std::exception_ptr& e) {
+		std::unique_lock<std::mutex> lock(this->m);
+
+		if(e && !this->error)
+			this->error = e;
+
+		// The caller may return as soon as it sees zero, so nothing is touched after this.
+		if(!--this->remaining)
+			this->done.notify_all();
+	}
+
+	ThreadPool::Batch::Batch(const size_t taskCount, const BatchTask& task)
+		: remaining(taskCount), task(task) {}
+
+	void ThreadPool::pin(std::thread& t, const size_t cpu) {
+		#if defined(_WIN32)
+			SetThreadAffinityMask(t.native_handle(), DWORD_PTR(1) << (cpu % (sizeof(DWORD_PTR) * 8)));
+		#elif defined(__linux__)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu % CPU_SETSIZE, &set);
+			pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+		#else
+			(void)t;
+			(void)cpu;
+		#endif
+	}
+
+	bool ThreadPool::tryRunTask(const size_t queueIdx) {
+		const auto queueCount = this->queues.size();
+		Task task;
+
+		// Own queue is used as a stack, the others are robbed from the opposite end.
+		for(size_t i = 0; i < queueCount && !task; i++) {
+			auto& q = *this->queues[(queueIdx + i) % queueCount];
+			std::unique_lock<std::mutex> lock(q.m);
+
+			if(q.tasks.empty())
+				continue;
+
+			if(i) {
+				task = std::move(q.tasks.front());
+				q.tasks.pop_front();
+			} else {
+				task = std::move(q.tasks.back());
+				q.tasks.pop_back();
+			}
+		}
+
+		if(!task)
+			return false;
+
+		this->queuedCount--;
+		task();
+		return true;
+	}
+
+	void ThreadPool::work(const size_t queueIdx) {
+		for(;;) {
+			if(this->tryRunTask(queueIdx))
+				continue;
+
+			std::unique_lock<std::mutex> lock(this->m);
+			this->cv.wait(lock, [this]() { return this->stopping || this->queuedCount.load(); });
+
+			if(this->stopping && !this->queuedCount.load())
+				return;
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::unique_lock<std::mutex> lock(this->m);
+			this->stopping = true;
+		}
+
+		this->cv.notify_all();
+
+		for(auto& t : this->threads)
+			t.join();
+	}
+
+	size_t ThreadPool::getWorkersNum() const {
+		return this->threads.size();
+	}
+
+	void ThreadPool::run(const size_t taskCount, const BatchTask& task) {
+		if(!taskCount)
+			return;
+
+		Batch batch(taskCount, task);
+
+		{
+			std::unique_lock<std::mutex> lock(this->m);
+			this->queuedCount += taskCount;
+
+			for(size_t i = 0; i < taskCount; i++) {
+				auto& q = *this->queues[i % this->queues.size()];
+				std::unique_lock<std::mutex> queueLock(q.m);
+				q.tasks.emplace_back([&batch, i]() {
+					std::exception_ptr e;
+
+					try {
+						batch.task(i);
+					} catch(...) {
+						e = std::current_exception();
+					}
+
+					batch.finish(e);
+				});
+			}
+		}
+
+		this->cv.notify_all();
+
+		// The caller helps instead of sleeping, so small batches rarely wait for a wake-up.
+		while(this->tryRunTask(0)) {}
+
+		std::unique_lock<std::mutex> lock(batch.m);
+		batch.done.wait(lock, [&batch]() { return !batch.remaining; });
+
+		if(batch.error)
+			std::rethrow_exception(batch.error);
+	}
+
+	ThreadPool::ThreadPool(const size_t workersNum, const bool pinThreads)
+		: queuedCount(0), stopping(false) {
+
+		if(!workersNum)
+			throw std::runtime_error("Workers number must be positive.");
+
+		const auto cpuCount = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+		this->queues.reserve(workersNum);
+		this->threads.reserve(workersNum);
+
+		for(size_t i = 0; i < workersNum; i++)
+			this->queues.push_back(std::make_unique<Queue>());
+
+		for(size_t i = 0; i < workersNum; i++) {
+			this->threads.emplace_back(&ThreadPool::work, this, i);
+
+			if(pinThreads)
+				ThreadPool::pin(this->threads.back(), i % cpuCount);
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chm {
+	class ThreadPool {
+	public:
+		using BatchTask = std::function<void(const size_t)>;
+		using Task = std::function<void()>;
+
+	private:
+		struct Batch {
+			std::condition_variable done;
+			std::exception_ptr error;
+			std::mutex m;
+			size_t remaining;
+			const BatchTask& task;
+
+			void finish(const std::exception_ptr& e);
+			Batch(const size_t taskCount, const BatchTask& task);
+		};
+
+		struct Queue {
+			std::mutex m;
+			std::deque<Task> tasks;
+		};
+
+		std::condition_variable cv;
+		std::mutex m;
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::atomic<size_t> queuedCount;
+		bool stopping;
+		std::vector<std::thread> threads;
+
+		static void pin(std::thread& t, const size_t cpu);
+		bool tryRunTask(const size_t queueIdx);
+		void work(const size_t queueIdx);
+
+	public:
+		~ThreadPool();
+		size_t getWorkersNum() const;
+		void run(const size_t taskCount, const BatchTask& task);
+		ThreadPool(const size_t workersNum, const bool pinThreads = false);
+	};
+
+	using ThreadPoolPtr = std::shared_ptr<ThreadPool>;
+}
@@ -19,8 +19,16 @@ namespace chm {
 
 	FunctionInfo euc(euclideanDistance, "euc");
 
+	static void euclideanDistanceBatch(
+		const float* query, const float* const* nodes, const size_t count, float* const res,
+		const size_t dim, const size_t, const size_t
+	) {
+		for(size_t i = 0; i < count; i++)
+			res[i] = euclideanDistance(nodes[i], query, dim, 0, 0, 0);
+	}
+
 	#if defined(AVX_CAPABLE)
-		static float euclideanDistance16AVX(
+		TARGET_AVX static float euclideanDistance16AVX(
 			const float* node, const float* query, const size_t,
 			const size_t, const size_t dim16, const size_t
 		) {
@@ -51,7 +59,7 @@ namespace chm {
 				tmp[4] + tmp[5] + tmp[6] + tmp[7];
 		}
 
-		static float euclideanDistance16ResidualAVX(
+		TARGET_AVX static float euclideanDistance16ResidualAVX(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -60,12 +68,52 @@ namespace chm {
 			return front + back;
 		}
 
+		TARGET_AVX static void euclideanDistanceBatch16AVX(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t dim4, const size_t dim16
+		) {
+			const auto dimLeft = dim - dim16;
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const float* a = nodes[i];
+				const float* b = nodes[i + 1];
+				const float* c = nodes[i + 2];
+				const float* d = nodes[i + 3];
+				__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim16; j += 8) {
+					const __m256 q = _mm256_loadu_ps(query + j);
+					const __m256 diffA = _mm256_sub_ps(_mm256_loadu_ps(a + j), q);
+					const __m256 diffB = _mm256_sub_ps(_mm256_loadu_ps(b + j), q);
+					const __m256 diffC = _mm256_sub_ps(_mm256_loadu_ps(c + j), q);
+					const __m256 diffD = _mm256_sub_ps(_mm256_loadu_ps(d + j), q);
+					sumA = _mm256_add_ps(sumA, _mm256_mul_ps(diffA, diffA));
+					sumB = _mm256_add_ps(sumB, _mm256_mul_ps(diffB, diffB));
+					sumC = _mm256_add_ps(sumC, _mm256_mul_ps(diffC, diffC));
+					sumD = _mm256_add_ps(sumD, _mm256_mul_ps(diffD, diffD));
+				}
+
+				res[i] = horizontalSum(sumA) +
+					euclideanDistance(a + dim16, query + dim16, dimLeft, 0, 0, 0);
+				res[i + 1] = horizontalSum(sumB) +
+					euclideanDistance(b + dim16, query + dim16, dimLeft, 0, 0, 0);
+				res[i + 2] = horizontalSum(sumC) +
+					euclideanDistance(c + dim16, query + dim16, dimLeft, 0, 0, 0);
+				res[i + 3] = horizontalSum(sumD) +
+					euclideanDistance(d + dim16, query + dim16, dimLeft, 0, 0, 0);
+			}
+
+			for(; i < count; i++)
+				res[i] = euclideanDistance16ResidualAVX(nodes[i], query, dim, dim4, dim16, dimLeft);
+		}
+
 		FunctionInfo euc16AVX(euclideanDistance16AVX, "euc16AVX");
 		FunctionInfo euc16RAVX(euclideanDistance16ResidualAVX, "euc16RAVX");
 	#endif
 
 	#if defined(AVX512_CAPABLE)
-		static float euclideanDistance16AVX512(
+		TARGET_AVX512 static float euclideanDistance16AVX512(
 			const float* node, const float* query, const size_t,
 			const size_t, const size_t dim16, const size_t
 		) {
@@ -91,7 +139,7 @@ namespace chm {
 				tmp[12] + tmp[13] + tmp[14] + tmp[15];
 		}
 
-		static float euclideanDistance16ResidualAVX512(
+		TARGET_AVX512 static float euclideanDistance16ResidualAVX512(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -100,12 +148,52 @@ namespace chm {
 			return front + back;
 		}
 
+		TARGET_AVX512 static void euclideanDistanceBatch16AVX512(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t dim4, const size_t dim16
+		) {
+			const auto dimLeft = dim - dim16;
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const float* a = nodes[i];
+				const float* b = nodes[i + 1];
+				const float* c = nodes[i + 2];
+				const float* d = nodes[i + 3];
+				__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim16; j += 16) {
+					const __m512 q = _mm512_loadu_ps(query + j);
+					const __m512 diffA = _mm512_sub_ps(_mm512_loadu_ps(a + j), q);
+					const __m512 diffB = _mm512_sub_ps(_mm512_loadu_ps(b + j), q);
+					const __m512 diffC = _mm512_sub_ps(_mm512_loadu_ps(c + j), q);
+					const __m512 diffD = _mm512_sub_ps(_mm512_loadu_ps(d + j), q);
+					sumA = _mm512_add_ps(sumA, _mm512_mul_ps(diffA, diffA));
+					sumB = _mm512_add_ps(sumB, _mm512_mul_ps(diffB, diffB));
+					sumC = _mm512_add_ps(sumC, _mm512_mul_ps(diffC, diffC));
+					sumD = _mm512_add_ps(sumD, _mm512_mul_ps(diffD, diffD));
+				}
+
+				res[i] = horizontalSum(sumA) +
+					euclideanDistance(a + dim16, query + dim16, dimLeft, 0, 0, 0);
+				res[i + 1] = horizontalSum(sumB) +
+					euclideanDistance(b + dim16, query + dim16, dimLeft, 0, 0, 0);
+				res[i + 2] = horizontalSum(sumC) +
+					euclideanDistance(c + dim16, query + dim16, dimLeft, 0, 0, 0);
+				res[i + 3] = horizontalSum(sumD) +
+					euclideanDistance(d + dim16, query + dim16, dimLeft, 0, 0, 0);
+			}
+
+			for(; i < count; i++)
+				res[i] = euclideanDistance16ResidualAVX512(nodes[i], query, dim, dim4, dim16, dimLeft);
+		}
+
 		FunctionInfo euc16AVX512(euclideanDistance16AVX512, "euc16AVX512");
 		FunctionInfo euc16RAVX512(euclideanDistance16ResidualAVX512, "euc16RAVX512");
 	#endif
 
 	#if defined(SSE_CAPABLE)
-		static float euclideanDistance16SSE(
+		TARGET_SSE static float euclideanDistance16SSE(
 			const float* node, const float* query, const size_t,
 			const size_t, const size_t dim16, const size_t
 		) {
@@ -148,7 +236,7 @@ namespace chm {
 			return tmp[0] + tmp[1] + tmp[2] + tmp[3];
 		}
 
-		static float euclideanDistance4SSE(
+		TARGET_SSE static float euclideanDistance4SSE(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t, const size_t
 		) {
@@ -170,7 +258,7 @@ namespace chm {
 			return tmp[0] + tmp[1] + tmp[2] + tmp[3];
 		}
 
-		static float euclideanDistance4ResidualSSE(
+		TARGET_SSE static float euclideanDistance4ResidualSSE(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -179,7 +267,7 @@ namespace chm {
 			return front + back;
 		}
 
-		static float euclideanDistance16ResidualSSE(
+		TARGET_SSE static float euclideanDistance16ResidualSSE(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -188,12 +276,424 @@ namespace chm {
 			return front + back;
 		}
 
+		TARGET_SSE static void euclideanDistanceBatch4SSE(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t dim4, const size_t dim16
+		) {
+			const auto dimLeft = dim - dim4;
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const float* a = nodes[i];
+				const float* b = nodes[i + 1];
+				const float* c = nodes[i + 2];
+				const float* d = nodes[i + 3];
+				__m128 sumA = _mm_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim4; j += 4) {
+					const __m128 q = _mm_loadu_ps(query + j);
+					const __m128 diffA = _mm_sub_ps(_mm_loadu_ps(a + j), q);
+					const __m128 diffB = _mm_sub_ps(_mm_loadu_ps(b + j), q);
+					const __m128 diffC = _mm_sub_ps(_mm_loadu_ps(c + j), q);
+					const __m128 diffD = _mm_sub_ps(_mm_loadu_ps(d + j), q);
+					sumA = _mm_add_ps(sumA, _mm_mul_ps(diffA, diffA));
+					sumB = _mm_add_ps(sumB, _mm_mul_ps(diffB, diffB));
+					sumC = _mm_add_ps(sumC, _mm_mul_ps(diffC, diffC));
+					sumD = _mm_add_ps(sumD, _mm_mul_ps(diffD, diffD));
+				}
+
+				res[i] = horizontalSum(sumA) +
+					euclideanDistance(a + dim4, query + dim4, dimLeft, 0, 0, 0);
+				res[i + 1] = horizontalSum(sumB) +
+					euclideanDistance(b + dim4, query + dim4, dimLeft, 0, 0, 0);
+				res[i + 2] = horizontalSum(sumC) +
+					euclideanDistance(c + dim4, query + dim4, dimLeft, 0, 0, 0);
+				res[i + 3] = horizontalSum(sumD) +
+					euclideanDistance(d + dim4, query + dim4, dimLeft, 0, 0, 0);
+			}
+
+			for(; i < count; i++)
+				res[i] = euclideanDistance4ResidualSSE(nodes[i], query, dim, dim4, dim16, dimLeft);
+		}
+
 		FunctionInfo euc16SSE(euclideanDistance16SSE, "euc16SSE");
 		FunctionInfo euc4SSE(euclideanDistance4SSE, "euc4SSE");
 		FunctionInfo euc4RSSE(euclideanDistance4ResidualSSE, "euc4RSSE");
 		FunctionInfo euc16RSSE(euclideanDistance16ResidualSSE, "euc16RSSE");
 	#endif
 
+	// Four independent FMA chains hide the instruction latency and a masked load covers the tail,
+	// so these kernels take any dimension.
+	#if defined(AVX_CAPABLE)
+		TARGET_AVX2 static float euclideanDistanceAVX2(
+			const float* node, const float* query, const size_t dim,
+			const size_t, const size_t, const size_t
+		) {
+			__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+			size_t i = 0;
+
+			for(; i + 32 <= dim; i += 32) {
+				const __m256 diffA = _mm256_sub_ps(
+					_mm256_loadu_ps(node + i), _mm256_loadu_ps(query + i)
+				);
+				const __m256 diffB = _mm256_sub_ps(
+					_mm256_loadu_ps(node + i + 8), _mm256_loadu_ps(query + i + 8)
+				);
+				const __m256 diffC = _mm256_sub_ps(
+					_mm256_loadu_ps(node + i + 16), _mm256_loadu_ps(query + i + 16)
+				);
+				const __m256 diffD = _mm256_sub_ps(
+					_mm256_loadu_ps(node + i + 24), _mm256_loadu_ps(query + i + 24)
+				);
+				sumA = _mm256_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm256_fmadd_ps(diffB, diffB, sumB);
+				sumC = _mm256_fmadd_ps(diffC, diffC, sumC);
+				sumD = _mm256_fmadd_ps(diffD, diffD, sumD);
+			}
+
+			for(; i + 8 <= dim; i += 8) {
+				const __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(node + i), _mm256_loadu_ps(query + i));
+				sumA = _mm256_fmadd_ps(diff, diff, sumA);
+			}
+
+			if(i < dim) {
+				const auto mask = tailMask8(dim - i);
+				const __m256 diff = _mm256_sub_ps(
+					_mm256_maskload_ps(node + i, mask), _mm256_maskload_ps(query + i, mask)
+				);
+				sumB = _mm256_fmadd_ps(diff, diff, sumB);
+			}
+
+			return reduceSum(_mm256_add_ps(_mm256_add_ps(sumA, sumB), _mm256_add_ps(sumC, sumD)));
+		}
+
+		// Four candidates share every query load, and their sums form four independent FMA chains.
+		TARGET_AVX2 static inline void euclideanDistanceQuadAVX2(
+			const float* query, const float* const* nodes, float* const res, const size_t dim
+		) {
+			const float* a = nodes[0];
+			const float* b = nodes[1];
+			const float* c = nodes[2];
+			const float* d = nodes[3];
+			__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+			size_t j = 0;
+
+			for(; j + 8 <= dim; j += 8) {
+				const __m256 q = _mm256_loadu_ps(query + j);
+				const __m256 diffA = _mm256_sub_ps(_mm256_loadu_ps(a + j), q);
+				const __m256 diffB = _mm256_sub_ps(_mm256_loadu_ps(b + j), q);
+				const __m256 diffC = _mm256_sub_ps(_mm256_loadu_ps(c + j), q);
+				const __m256 diffD = _mm256_sub_ps(_mm256_loadu_ps(d + j), q);
+				sumA = _mm256_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm256_fmadd_ps(diffB, diffB, sumB);
+				sumC = _mm256_fmadd_ps(diffC, diffC, sumC);
+				sumD = _mm256_fmadd_ps(diffD, diffD, sumD);
+			}
+
+			if(j < dim) {
+				const auto mask = tailMask8(dim - j);
+				const __m256 q = _mm256_maskload_ps(query + j, mask);
+				const __m256 diffA = _mm256_sub_ps(_mm256_maskload_ps(a + j, mask), q);
+				const __m256 diffB = _mm256_sub_ps(_mm256_maskload_ps(b + j, mask), q);
+				const __m256 diffC = _mm256_sub_ps(_mm256_maskload_ps(c + j, mask), q);
+				const __m256 diffD = _mm256_sub_ps(_mm256_maskload_ps(d + j, mask), q);
+				sumA = _mm256_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm256_fmadd_ps(diffB, diffB, sumB);
+				sumC = _mm256_fmadd_ps(diffC, diffC, sumC);
+				sumD = _mm256_fmadd_ps(diffD, diffD, sumD);
+			}
+
+			res[0] = reduceSum(sumA);
+			res[1] = reduceSum(sumB);
+			res[2] = reduceSum(sumC);
+			res[3] = reduceSum(sumD);
+		}
+
+		TARGET_AVX2 static void euclideanDistanceBatchAVX2(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t, const size_t
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4)
+				euclideanDistanceQuadAVX2(query, nodes + i, res + i, dim);
+
+			for(; i < count; i++)
+				res[i] = euclideanDistanceAVX2(nodes[i], query, dim, 0, 0, 0);
+		}
+
+		FunctionInfo eucAVX2(euclideanDistanceAVX2, "eucAVX2");
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		TARGET_AVX512 static float euclideanDistanceAVX512FMA(
+			const float* node, const float* query, const size_t dim,
+			const size_t, const size_t, const size_t
+		) {
+			__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+			size_t i = 0;
+
+			for(; i + 64 <= dim; i += 64) {
+				const __m512 diffA = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i), _mm512_loadu_ps(query + i)
+				);
+				const __m512 diffB = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i + 16), _mm512_loadu_ps(query + i + 16)
+				);
+				const __m512 diffC = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i + 32), _mm512_loadu_ps(query + i + 32)
+				);
+				const __m512 diffD = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i + 48), _mm512_loadu_ps(query + i + 48)
+				);
+				sumA = _mm512_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm512_fmadd_ps(diffB, diffB, sumB);
+				sumC = _mm512_fmadd_ps(diffC, diffC, sumC);
+				sumD = _mm512_fmadd_ps(diffD, diffD, sumD);
+			}
+
+			for(; i + 16 <= dim; i += 16) {
+				const __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(node + i), _mm512_loadu_ps(query + i));
+				sumA = _mm512_fmadd_ps(diff, diff, sumA);
+			}
+
+			if(i < dim) {
+				const auto mask = __mmask16((1u << (dim - i)) - 1);
+				const __m512 diff = _mm512_sub_ps(
+					_mm512_maskz_loadu_ps(mask, node + i), _mm512_maskz_loadu_ps(mask, query + i)
+				);
+				sumB = _mm512_fmadd_ps(diff, diff, sumB);
+			}
+
+			return reduceSum(_mm512_add_ps(_mm512_add_ps(sumA, sumB), _mm512_add_ps(sumC, sumD)));
+		}
+
+		// Four candidates share every query load, and their sums form four independent FMA chains.
+		TARGET_AVX512 static inline void euclideanDistanceQuadAVX512FMA(
+			const float* query, const float* const* nodes, float* const res, const size_t dim
+		) {
+			const float* a = nodes[0];
+			const float* b = nodes[1];
+			const float* c = nodes[2];
+			const float* d = nodes[3];
+			__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+			size_t j = 0;
+
+			for(; j + 16 <= dim; j += 16) {
+				const __m512 q = _mm512_loadu_ps(query + j);
+				const __m512 diffA = _mm512_sub_ps(_mm512_loadu_ps(a + j), q);
+				const __m512 diffB = _mm512_sub_ps(_mm512_loadu_ps(b + j), q);
+				const __m512 diffC = _mm512_sub_ps(_mm512_loadu_ps(c + j), q);
+				const __m512 diffD = _mm512_sub_ps(_mm512_loadu_ps(d + j), q);
+				sumA = _mm512_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm512_fmadd_ps(diffB, diffB, sumB);
+				sumC = _mm512_fmadd_ps(diffC, diffC, sumC);
+				sumD = _mm512_fmadd_ps(diffD, diffD, sumD);
+			}
+
+			if(j < dim) {
+				const auto mask = __mmask16((1u << (dim - j)) - 1);
+				const __m512 q = _mm512_maskz_loadu_ps(mask, query + j);
+				const __m512 diffA = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + j), q);
+				const __m512 diffB = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, b + j), q);
+				const __m512 diffC = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, c + j), q);
+				const __m512 diffD = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, d + j), q);
+				sumA = _mm512_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm512_fmadd_ps(diffB, diffB, sumB);
+				sumC = _mm512_fmadd_ps(diffC, diffC, sumC);
+				sumD = _mm512_fmadd_ps(diffD, diffD, sumD);
+			}
+
+			res[0] = reduceSum(sumA);
+			res[1] = reduceSum(sumB);
+			res[2] = reduceSum(sumC);
+			res[3] = reduceSum(sumD);
+		}
+
+		TARGET_AVX512 static void euclideanDistanceBatchAVX512FMA(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t, const size_t
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4)
+				euclideanDistanceQuadAVX512FMA(query, nodes + i, res + i, dim);
+
+			for(; i < count; i++)
+				res[i] = euclideanDistanceAVX512FMA(nodes[i], query, dim, 0, 0, 0);
+		}
+
+		FunctionInfo eucAVX512FMA(euclideanDistanceAVX512FMA, "eucAVX512FMA");
+	#endif
+
+	// Dimensions served in production get kernels of their own. The bounds are compile-time constants,
+	// so the loops unroll completely and need no tail.
+	#if defined(AVX_CAPABLE)
+		template<size_t D>
+		TARGET_AVX2 static float euclideanDistanceFixedAVX2(
+			const float* node, const float* query, const size_t,
+			const size_t, const size_t, const size_t
+		) {
+			static_assert(D % 32 == 0, "The dimension must be a multiple of 32.");
+			__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+			UNROLL_LOOP
+			for(size_t i = 0; i + 32 <= D; i += 32) {
+				const __m256 diffA = _mm256_sub_ps(
+					_mm256_loadu_ps(node + i), _mm256_loadu_ps(query + i)
+				);
+				const __m256 diffB = _mm256_sub_ps(
+					_mm256_loadu_ps(node + i + 8), _mm256_loadu_ps(query + i + 8)
+				);
+				const __m256 diffC = _mm256_sub_ps(
+					_mm256_loadu_ps(node + i + 16), _mm256_loadu_ps(query + i + 16)
+				);
+				const __m256 diffD = _mm256_sub_ps(
+					_mm256_loadu_ps(node + i + 24), _mm256_loadu_ps(query + i + 24)
+				);
+				sumA = _mm256_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm256_fmadd_ps(diffB, diffB, sumB);
+				sumC = _mm256_fmadd_ps(diffC, diffC, sumC);
+				sumD = _mm256_fmadd_ps(diffD, diffD, sumD);
+			}
+
+			return reduceSum(_mm256_add_ps(_mm256_add_ps(sumA, sumB), _mm256_add_ps(sumC, sumD)));
+		}
+
+		template<size_t D>
+		TARGET_AVX2 static void euclideanDistanceBatchFixedAVX2(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t, const size_t, const size_t
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4)
+				euclideanDistanceQuadAVX2(query, nodes + i, res + i, D);
+
+			for(; i < count; i++)
+				res[i] = euclideanDistanceFixedAVX2<D>(nodes[i], query, D, 0, 0, 0);
+		}
+
+		const FixedDimKernel eucFixedAVX2[] = {
+			{
+				euclideanDistanceBatchFixedAVX2<96>, 96,
+				{euclideanDistanceFixedAVX2<96>, "euc96AVX2"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX2<128>, 128,
+				{euclideanDistanceFixedAVX2<128>, "euc128AVX2"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX2<256>, 256,
+				{euclideanDistanceFixedAVX2<256>, "euc256AVX2"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX2<384>, 384,
+				{euclideanDistanceFixedAVX2<384>, "euc384AVX2"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX2<768>, 768,
+				{euclideanDistanceFixedAVX2<768>, "euc768AVX2"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX2<960>, 960,
+				{euclideanDistanceFixedAVX2<960>, "euc960AVX2"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX2<1536>, 1536,
+				{euclideanDistanceFixedAVX2<1536>, "euc1536AVX2"}
+			}
+		};
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		template<size_t D>
+		TARGET_AVX512 static float euclideanDistanceFixedAVX512(
+			const float* node, const float* query, const size_t,
+			const size_t, const size_t, const size_t
+		) {
+			static_assert(D % 32 == 0, "The dimension must be a multiple of 32.");
+			__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+			UNROLL_LOOP
+			for(size_t i = 0; i + 64 <= D; i += 64) {
+				const __m512 diffA = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i), _mm512_loadu_ps(query + i)
+				);
+				const __m512 diffB = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i + 16), _mm512_loadu_ps(query + i + 16)
+				);
+				const __m512 diffC = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i + 32), _mm512_loadu_ps(query + i + 32)
+				);
+				const __m512 diffD = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i + 48), _mm512_loadu_ps(query + i + 48)
+				);
+				sumA = _mm512_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm512_fmadd_ps(diffB, diffB, sumB);
+				sumC = _mm512_fmadd_ps(diffC, diffC, sumC);
+				sumD = _mm512_fmadd_ps(diffD, diffD, sumD);
+			}
+
+			if constexpr(D % 64 != 0) {
+				constexpr size_t i = D - 32;
+				const __m512 diffA = _mm512_sub_ps(_mm512_loadu_ps(node + i), _mm512_loadu_ps(query + i));
+				const __m512 diffB = _mm512_sub_ps(
+					_mm512_loadu_ps(node + i + 16), _mm512_loadu_ps(query + i + 16)
+				);
+				sumA = _mm512_fmadd_ps(diffA, diffA, sumA);
+				sumB = _mm512_fmadd_ps(diffB, diffB, sumB);
+			}
+
+			return reduceSum(_mm512_add_ps(_mm512_add_ps(sumA, sumB), _mm512_add_ps(sumC, sumD)));
+		}
+
+		template<size_t D>
+		TARGET_AVX512 static void euclideanDistanceBatchFixedAVX512(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t, const size_t, const size_t
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4)
+				euclideanDistanceQuadAVX512FMA(query, nodes + i, res + i, D);
+
+			for(; i < count; i++)
+				res[i] = euclideanDistanceFixedAVX512<D>(nodes[i], query, D, 0, 0, 0);
+		}
+
+		const FixedDimKernel eucFixedAVX512FMA[] = {
+			{
+				euclideanDistanceBatchFixedAVX512<96>, 96,
+				{euclideanDistanceFixedAVX512<96>, "euc96AVX512FMA"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX512<128>, 128,
+				{euclideanDistanceFixedAVX512<128>, "euc128AVX512FMA"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX512<256>, 256,
+				{euclideanDistanceFixedAVX512<256>, "euc256AVX512FMA"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX512<384>, 384,
+				{euclideanDistanceFixedAVX512<384>, "euc384AVX512FMA"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX512<768>, 768,
+				{euclideanDistanceFixedAVX512<768>, "euc768AVX512FMA"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX512<960>, 960,
+				{euclideanDistanceFixedAVX512<960>, "euc960AVX512FMA"}
+			},
+			{
+				euclideanDistanceBatchFixedAVX512<1536>, 1536,
+				{euclideanDistanceFixedAVX512<1536>, "euc1536AVX512FMA"}
+			}
+		};
+	#endif
+
 	inline DistanceInfo getEuclideanInfo(
 		const size_t dim, const size_t dim4, const size_t dim16, SIMDType type
 	) {
@@ -204,6 +704,21 @@ namespace chm {
 			if(type == SIMDType::BEST)
 				type = getBestSIMDType();
 
+			checkSIMDType(type);
+
+			#if defined(AVX_CAPABLE)
+				if(type == SIMDType::AVX2) {
+					const auto fixed = findFixedDimKernel(eucFixedAVX2, dim);
+					return DistanceInfo(0, fixed ? fixed->funcInfo : eucAVX2);
+				}
+			#endif
+			#if defined(AVX512_CAPABLE)
+				if(type == SIMDType::AVX512FMA) {
+					const auto fixed = findFixedDimKernel(eucFixedAVX512FMA, dim);
+					return DistanceInfo(0, fixed ? fixed->funcInfo : eucAVX512FMA);
+				}
+			#endif
+
 			if(dim % 16 == 0)
 				switch(type) {
 					case SIMDType::AVX:
@@ -269,4 +784,178 @@ namespace chm {
 
 		return DistanceInfo(0, euc);
 	}
+
+	inline BatchDistanceFunction getEuclideanBatchFunction(const size_t dim, SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::NONE)
+				return euclideanDistanceBatch;
+
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+					#if defined(AVX_CAPABLE)
+						return euclideanDistanceBatch16AVX;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX.");
+					#endif
+				case SIMDType::AVX512:
+					#if defined(AVX512_CAPABLE)
+						return euclideanDistanceBatch16AVX512;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(const auto fixed = findFixedDimKernel(eucFixedAVX2, dim))
+							return fixed->batch;
+						return euclideanDistanceBatchAVX2;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX2 and FMA.");
+					#endif
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						if(const auto fixed = findFixedDimKernel(eucFixedAVX512FMA, dim))
+							return fixed->batch;
+						return euclideanDistanceBatchAVX512FMA;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				case SIMDType::SSE:
+					#if defined(SSE_CAPABLE)
+						return euclideanDistanceBatch4SSE;
+					#else
+						throw std::runtime_error("This CPU doesn't support SSE.");
+					#endif
+				default:
+					throw std::runtime_error("Unknown SIMD type.");
+			}
+		#endif
+
+		return euclideanDistanceBatch;
+	}
+
+	// Half vectors and their prepared queries are padded with zeros to a multiple of 16.
+	template<float (*convert)(const uint16_t)>
+	static void euclideanDistanceHalfBatch(
+		const float* query, const float*, const uint8_t* const* nodes, const size_t count,
+		float* const res, const size_t dim
+	) {
+		for(size_t i = 0; i < count; i++) {
+			const auto node = reinterpret_cast<const uint16_t*>(nodes[i]);
+			auto sum = 0.f;
+
+			for(size_t j = 0; j < dim; j++) {
+				const auto diff = convert(node[j]) - query[j];
+				sum += diff * diff;
+			}
+
+			res[i] = sum;
+		}
+	}
+
+	#if defined(AVX_CAPABLE)
+		template<__m256 (*load)(const uint16_t*)>
+		TARGET_AVX2 static void euclideanDistanceHalfBatchAVX(
+			const float* query, const float*, const uint8_t* const* nodes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			for(size_t i = 0; i < count; i++) {
+				const auto node = reinterpret_cast<const uint16_t*>(nodes[i]);
+				__m256 sumA = _mm256_setzero_ps(), sumB = sumA;
+
+				for(size_t j = 0; j < dim; j += 16) {
+					const __m256 diffA = _mm256_sub_ps(load(node + j), _mm256_loadu_ps(query + j));
+					const __m256 diffB = _mm256_sub_ps(load(node + j + 8), _mm256_loadu_ps(query + j + 8));
+					sumA = _mm256_add_ps(sumA, _mm256_mul_ps(diffA, diffA));
+					sumB = _mm256_add_ps(sumB, _mm256_mul_ps(diffB, diffB));
+				}
+
+				res[i] = horizontalSum(_mm256_add_ps(sumA, sumB));
+			}
+		}
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		template<__m512 (*load)(const uint16_t*)>
+		TARGET_AVX512 static void euclideanDistanceHalfBatchAVX512(
+			const float* query, const float*, const uint8_t* const* nodes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			for(size_t i = 0; i < count; i++) {
+				const auto node = reinterpret_cast<const uint16_t*>(nodes[i]);
+				__m512 sum = _mm512_setzero_ps();
+
+				for(size_t j = 0; j < dim; j += 16) {
+					const __m512 diff = _mm512_sub_ps(load(node + j), _mm512_loadu_ps(query + j));
+					sum = _mm512_add_ps(sum, _mm512_mul_ps(diff, diff));
+				}
+
+				res[i] = horizontalSum(sum);
+			}
+		}
+	#endif
+
+	inline QuantizedDistanceFunction getEuclideanBF16BatchFunction(SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(getCPUFeatures().avx2)
+							return euclideanDistanceHalfBatchAVX<loadBF16x8AVX>;
+					#endif
+					break;
+				case SIMDType::AVX512:
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						return euclideanDistanceHalfBatchAVX512<loadBF16x16AVX512>;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				default:
+					break;
+			}
+		#endif
+
+		return euclideanDistanceHalfBatch<bf16ToFloat>;
+	}
+
+	inline QuantizedDistanceFunction getEuclideanFP16BatchFunction(SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(getCPUFeatures().avx2)
+							return euclideanDistanceHalfBatchAVX<loadHalf8AVX>;
+					#endif
+					break;
+				case SIMDType::AVX512:
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						return euclideanDistanceHalfBatchAVX512<loadHalf16AVX512>;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				default:
+					break;
+			}
+		#endif
+
+		return euclideanDistanceHalfBatch<halfToFloat>;
+	}
 }
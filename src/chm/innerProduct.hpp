@@ -20,8 +20,16 @@ namespace chm {
 
 	FunctionInfo ip(innerProduct, "ip");
 
+	static void innerProductBatch(
+		const float* query, const float* const* nodes, const size_t count, float* const res,
+		const size_t dim, const size_t, const size_t
+	) {
+		for(size_t i = 0; i < count; i++)
+			res[i] = innerProduct(nodes[i], query, dim, 0, 0, 0);
+	}
+
 	#if defined(AVX_CAPABLE)
-		static float innerProductSum16AVX(const float* node, const float* query, const size_t dim16) {
+		TARGET_AVX static float innerProductSum16AVX(const float* node, const float* query, const size_t dim16) {
 			const float* end = node + dim16;
 			__m256 sum = _mm256_set1_ps(0);
 			float PORTABLE_ALIGN32 tmp[8];
@@ -46,14 +54,14 @@ namespace chm {
 				tmp[4] + tmp[5] + tmp[6] + tmp[7];
 		}
 
-		static float innerProduct16AVX(
+		TARGET_AVX static float innerProduct16AVX(
 			const float* node, const float* query, const size_t,
 			const size_t, const size_t dim16, const size_t
 		) {
 			return 1.f - innerProductSum16AVX(node, query, dim16);
 		}
 
-		static float innerProduct16ResidualAVX(
+		TARGET_AVX static float innerProduct16ResidualAVX(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -62,7 +70,7 @@ namespace chm {
 			return 1.f - (front + back);
 		}
 
-		static float innerProductSum4AVX(
+		TARGET_AVX static float innerProductSum4AVX(
 			const float* node, const float* query, const size_t dim4, const size_t dim16
 		) {
 			const float* end4 = node + dim4;
@@ -99,14 +107,14 @@ namespace chm {
 			return tmp[0] + tmp[1] + tmp[2] + tmp[3];
 		}
 
-		static float innerProduct4AVX(
+		TARGET_AVX static float innerProduct4AVX(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t
 		) {
 			return 1.f - innerProductSum4AVX(node, query, dim4, dim16);
 		}
 
-		static float innerProduct4ResidualAVX(
+		TARGET_AVX static float innerProduct4ResidualAVX(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -115,6 +123,46 @@ namespace chm {
 			return 1.f - (front + back);
 		}
 
+		TARGET_AVX static void innerProductBatch16AVX(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t dim4, const size_t dim16
+		) {
+			const auto dimLeft = dim - dim16;
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const float* a = nodes[i];
+				const float* b = nodes[i + 1];
+				const float* c = nodes[i + 2];
+				const float* d = nodes[i + 3];
+				__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim16; j += 8) {
+					const __m256 q = _mm256_loadu_ps(query + j);
+					sumA = _mm256_add_ps(sumA, _mm256_mul_ps(_mm256_loadu_ps(a + j), q));
+					sumB = _mm256_add_ps(sumB, _mm256_mul_ps(_mm256_loadu_ps(b + j), q));
+					sumC = _mm256_add_ps(sumC, _mm256_mul_ps(_mm256_loadu_ps(c + j), q));
+					sumD = _mm256_add_ps(sumD, _mm256_mul_ps(_mm256_loadu_ps(d + j), q));
+				}
+
+				res[i] = 1.f - (
+					horizontalSum(sumA) + innerProductSum(a + dim16, query + dim16, dimLeft)
+				);
+				res[i + 1] = 1.f - (
+					horizontalSum(sumB) + innerProductSum(b + dim16, query + dim16, dimLeft)
+				);
+				res[i + 2] = 1.f - (
+					horizontalSum(sumC) + innerProductSum(c + dim16, query + dim16, dimLeft)
+				);
+				res[i + 3] = 1.f - (
+					horizontalSum(sumD) + innerProductSum(d + dim16, query + dim16, dimLeft)
+				);
+			}
+
+			for(; i < count; i++)
+				res[i] = innerProduct16ResidualAVX(nodes[i], query, dim, dim4, dim16, dimLeft);
+		}
+
 		FunctionInfo ip16AVX(innerProduct16AVX, "ip16AVX");
 		FunctionInfo ip16RAVX(innerProduct16ResidualAVX, "ip16RAVX");
 		FunctionInfo ip4AVX(innerProduct4AVX, "ip4AVX");
@@ -122,7 +170,7 @@ namespace chm {
 	#endif
 
 	#if defined(AVX512_CAPABLE)
-		static float innerProductSum16AVX512(
+		TARGET_AVX512 static float innerProductSum16AVX512(
 			const float* node, const float* query, const size_t dim16
 		) {
 			const float* end = node + dim16;
@@ -145,14 +193,14 @@ namespace chm {
 				tmp[12] + tmp[13] + tmp[14] + tmp[15];
 		}
 
-		static float innerProduct16AVX512(
+		TARGET_AVX512 static float innerProduct16AVX512(
 			const float* node, const float* query, const size_t,
 			const size_t, const size_t dim16, const size_t
 		) {
 			return 1.f - innerProductSum16AVX512(node, query, dim16);
 		}
 
-		static float innerProduct16ResidualAVX512(
+		TARGET_AVX512 static float innerProduct16ResidualAVX512(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -161,12 +209,52 @@ namespace chm {
 			return 1.f - (front + back);
 		}
 
+		TARGET_AVX512 static void innerProductBatch16AVX512(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t dim4, const size_t dim16
+		) {
+			const auto dimLeft = dim - dim16;
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const float* a = nodes[i];
+				const float* b = nodes[i + 1];
+				const float* c = nodes[i + 2];
+				const float* d = nodes[i + 3];
+				__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim16; j += 16) {
+					const __m512 q = _mm512_loadu_ps(query + j);
+					sumA = _mm512_add_ps(sumA, _mm512_mul_ps(_mm512_loadu_ps(a + j), q));
+					sumB = _mm512_add_ps(sumB, _mm512_mul_ps(_mm512_loadu_ps(b + j), q));
+					sumC = _mm512_add_ps(sumC, _mm512_mul_ps(_mm512_loadu_ps(c + j), q));
+					sumD = _mm512_add_ps(sumD, _mm512_mul_ps(_mm512_loadu_ps(d + j), q));
+				}
+
+				res[i] = 1.f - (
+					horizontalSum(sumA) + innerProductSum(a + dim16, query + dim16, dimLeft)
+				);
+				res[i + 1] = 1.f - (
+					horizontalSum(sumB) + innerProductSum(b + dim16, query + dim16, dimLeft)
+				);
+				res[i + 2] = 1.f - (
+					horizontalSum(sumC) + innerProductSum(c + dim16, query + dim16, dimLeft)
+				);
+				res[i + 3] = 1.f - (
+					horizontalSum(sumD) + innerProductSum(d + dim16, query + dim16, dimLeft)
+				);
+			}
+
+			for(; i < count; i++)
+				res[i] = innerProduct16ResidualAVX512(nodes[i], query, dim, dim4, dim16, dimLeft);
+		}
+
 		FunctionInfo ip16AVX512(innerProduct16AVX512, "ip16AVX512");
 		FunctionInfo ip16RAVX512(innerProduct16ResidualAVX512, "ip16RAVX512");
 	#endif
 
 	#if defined(SSE_CAPABLE)
-		static float innerProductSum16SSE(
+		TARGET_SSE static float innerProductSum16SSE(
 			const float* node, const float* query, const size_t dim16
 		) {
 			const float* end = node + dim16;
@@ -204,14 +292,14 @@ namespace chm {
 			return tmp[0] + tmp[1] + tmp[2] + tmp[3];
 		}
 
-		static float innerProduct16SSE(
+		TARGET_SSE static float innerProduct16SSE(
 			const float* node, const float* query, const size_t,
 			const size_t, const size_t dim16, const size_t
 		) {
 			return 1.f - innerProductSum16SSE(node, query, dim16);
 		}
 
-		static float innerProduct16ResidualSSE(
+		TARGET_SSE static float innerProduct16ResidualSSE(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -220,7 +308,7 @@ namespace chm {
 			return 1.f - (front + back);
 		}
 
-		static float innerProductSum4SSE(
+		TARGET_SSE static float innerProductSum4SSE(
 			const float* node, const float* query, const size_t dim4, const size_t dim16
 		) {
 			const float* end4 = node + dim4;
@@ -267,14 +355,14 @@ namespace chm {
 			return tmp[0] + tmp[1] + tmp[2] + tmp[3];
 		}
 
-		static float innerProduct4SSE(
+		TARGET_SSE static float innerProduct4SSE(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t
 		) {
 			return 1.f - innerProductSum4SSE(node, query, dim4, dim16);
 		}
 
-		static float innerProduct4ResidualSSE(
+		TARGET_SSE static float innerProduct4ResidualSSE(
 			const float* node, const float* query, const size_t,
 			const size_t dim4, const size_t dim16, const size_t dimLeft
 		) {
@@ -283,12 +371,376 @@ namespace chm {
 			return 1.f - (front + back);
 		}
 
+		TARGET_SSE static void innerProductBatch4SSE(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t dim4, const size_t dim16
+		) {
+			const auto dimLeft = dim - dim4;
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const float* a = nodes[i];
+				const float* b = nodes[i + 1];
+				const float* c = nodes[i + 2];
+				const float* d = nodes[i + 3];
+				__m128 sumA = _mm_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim4; j += 4) {
+					const __m128 q = _mm_loadu_ps(query + j);
+					sumA = _mm_add_ps(sumA, _mm_mul_ps(_mm_loadu_ps(a + j), q));
+					sumB = _mm_add_ps(sumB, _mm_mul_ps(_mm_loadu_ps(b + j), q));
+					sumC = _mm_add_ps(sumC, _mm_mul_ps(_mm_loadu_ps(c + j), q));
+					sumD = _mm_add_ps(sumD, _mm_mul_ps(_mm_loadu_ps(d + j), q));
+				}
+
+				res[i] = 1.f - (
+					horizontalSum(sumA) + innerProductSum(a + dim4, query + dim4, dimLeft)
+				);
+				res[i + 1] = 1.f - (
+					horizontalSum(sumB) + innerProductSum(b + dim4, query + dim4, dimLeft)
+				);
+				res[i + 2] = 1.f - (
+					horizontalSum(sumC) + innerProductSum(c + dim4, query + dim4, dimLeft)
+				);
+				res[i + 3] = 1.f - (
+					horizontalSum(sumD) + innerProductSum(d + dim4, query + dim4, dimLeft)
+				);
+			}
+
+			for(; i < count; i++)
+				res[i] = innerProduct4ResidualSSE(nodes[i], query, dim, dim4, dim16, dimLeft);
+		}
+
 		FunctionInfo ip16SSE(innerProduct16SSE, "ip16SSE");
 		FunctionInfo ip16RSSE(innerProduct16ResidualSSE, "ip16RSSE");
 		FunctionInfo ip4SSE(innerProduct4SSE, "ip4SSE");
 		FunctionInfo ip4RSSE(innerProduct4ResidualSSE, "ip4RSSE");
 	#endif
 
+	// Four independent FMA chains hide the instruction latency and a masked load covers the tail,
+	// so these kernels take any dimension.
+	#if defined(AVX_CAPABLE)
+		TARGET_AVX2 static float innerProductAVX2(
+			const float* node, const float* query, const size_t dim,
+			const size_t, const size_t, const size_t
+		) {
+			__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+			size_t i = 0;
+
+			for(; i + 32 <= dim; i += 32) {
+				sumA = _mm256_fmadd_ps(_mm256_loadu_ps(node + i), _mm256_loadu_ps(query + i), sumA);
+				sumB = _mm256_fmadd_ps(
+					_mm256_loadu_ps(node + i + 8), _mm256_loadu_ps(query + i + 8), sumB
+				);
+				sumC = _mm256_fmadd_ps(
+					_mm256_loadu_ps(node + i + 16), _mm256_loadu_ps(query + i + 16), sumC
+				);
+				sumD = _mm256_fmadd_ps(
+					_mm256_loadu_ps(node + i + 24), _mm256_loadu_ps(query + i + 24), sumD
+				);
+			}
+
+			for(; i + 8 <= dim; i += 8)
+				sumA = _mm256_fmadd_ps(_mm256_loadu_ps(node + i), _mm256_loadu_ps(query + i), sumA);
+
+			if(i < dim) {
+				const auto mask = tailMask8(dim - i);
+				sumB = _mm256_fmadd_ps(
+					_mm256_maskload_ps(node + i, mask), _mm256_maskload_ps(query + i, mask), sumB
+				);
+			}
+
+			return 1.f - reduceSum(_mm256_add_ps(_mm256_add_ps(sumA, sumB), _mm256_add_ps(sumC, sumD)));
+		}
+
+		// Four candidates share every query load, and their sums form four independent FMA chains.
+		TARGET_AVX2 static inline void innerProductQuadAVX2(
+			const float* query, const float* const* nodes, float* const res, const size_t dim
+		) {
+			const float* a = nodes[0];
+			const float* b = nodes[1];
+			const float* c = nodes[2];
+			const float* d = nodes[3];
+			__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+			size_t j = 0;
+
+			for(; j + 8 <= dim; j += 8) {
+				const __m256 q = _mm256_loadu_ps(query + j);
+				sumA = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), q, sumA);
+				sumB = _mm256_fmadd_ps(_mm256_loadu_ps(b + j), q, sumB);
+				sumC = _mm256_fmadd_ps(_mm256_loadu_ps(c + j), q, sumC);
+				sumD = _mm256_fmadd_ps(_mm256_loadu_ps(d + j), q, sumD);
+			}
+
+			if(j < dim) {
+				const auto mask = tailMask8(dim - j);
+				const __m256 q = _mm256_maskload_ps(query + j, mask);
+				sumA = _mm256_fmadd_ps(_mm256_maskload_ps(a + j, mask), q, sumA);
+				sumB = _mm256_fmadd_ps(_mm256_maskload_ps(b + j, mask), q, sumB);
+				sumC = _mm256_fmadd_ps(_mm256_maskload_ps(c + j, mask), q, sumC);
+				sumD = _mm256_fmadd_ps(_mm256_maskload_ps(d + j, mask), q, sumD);
+			}
+
+			res[0] = 1.f - reduceSum(sumA);
+			res[1] = 1.f - reduceSum(sumB);
+			res[2] = 1.f - reduceSum(sumC);
+			res[3] = 1.f - reduceSum(sumD);
+		}
+
+		TARGET_AVX2 static void innerProductBatchAVX2(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t, const size_t
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4)
+				innerProductQuadAVX2(query, nodes + i, res + i, dim);
+
+			for(; i < count; i++)
+				res[i] = innerProductAVX2(nodes[i], query, dim, 0, 0, 0);
+		}
+
+		FunctionInfo ipAVX2(innerProductAVX2, "ipAVX2");
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		TARGET_AVX512 static float innerProductAVX512FMA(
+			const float* node, const float* query, const size_t dim,
+			const size_t, const size_t, const size_t
+		) {
+			__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+			size_t i = 0;
+
+			for(; i + 64 <= dim; i += 64) {
+				sumA = _mm512_fmadd_ps(_mm512_loadu_ps(node + i), _mm512_loadu_ps(query + i), sumA);
+				sumB = _mm512_fmadd_ps(
+					_mm512_loadu_ps(node + i + 16), _mm512_loadu_ps(query + i + 16), sumB
+				);
+				sumC = _mm512_fmadd_ps(
+					_mm512_loadu_ps(node + i + 32), _mm512_loadu_ps(query + i + 32), sumC
+				);
+				sumD = _mm512_fmadd_ps(
+					_mm512_loadu_ps(node + i + 48), _mm512_loadu_ps(query + i + 48), sumD
+				);
+			}
+
+			for(; i + 16 <= dim; i += 16)
+				sumA = _mm512_fmadd_ps(_mm512_loadu_ps(node + i), _mm512_loadu_ps(query + i), sumA);
+
+			if(i < dim) {
+				const auto mask = __mmask16((1u << (dim - i)) - 1);
+				sumB = _mm512_fmadd_ps(
+					_mm512_maskz_loadu_ps(mask, node + i), _mm512_maskz_loadu_ps(mask, query + i), sumB
+				);
+			}
+
+			return 1.f - reduceSum(_mm512_add_ps(_mm512_add_ps(sumA, sumB), _mm512_add_ps(sumC, sumD)));
+		}
+
+		// Four candidates share every query load, and their sums form four independent FMA chains.
+		TARGET_AVX512 static inline void innerProductQuadAVX512FMA(
+			const float* query, const float* const* nodes, float* const res, const size_t dim
+		) {
+			const float* a = nodes[0];
+			const float* b = nodes[1];
+			const float* c = nodes[2];
+			const float* d = nodes[3];
+			__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+			size_t j = 0;
+
+			for(; j + 16 <= dim; j += 16) {
+				const __m512 q = _mm512_loadu_ps(query + j);
+				sumA = _mm512_fmadd_ps(_mm512_loadu_ps(a + j), q, sumA);
+				sumB = _mm512_fmadd_ps(_mm512_loadu_ps(b + j), q, sumB);
+				sumC = _mm512_fmadd_ps(_mm512_loadu_ps(c + j), q, sumC);
+				sumD = _mm512_fmadd_ps(_mm512_loadu_ps(d + j), q, sumD);
+			}
+
+			if(j < dim) {
+				const auto mask = __mmask16((1u << (dim - j)) - 1);
+				const __m512 q = _mm512_maskz_loadu_ps(mask, query + j);
+				sumA = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + j), q, sumA);
+				sumB = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, b + j), q, sumB);
+				sumC = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, c + j), q, sumC);
+				sumD = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, d + j), q, sumD);
+			}
+
+			res[0] = 1.f - reduceSum(sumA);
+			res[1] = 1.f - reduceSum(sumB);
+			res[2] = 1.f - reduceSum(sumC);
+			res[3] = 1.f - reduceSum(sumD);
+		}
+
+		TARGET_AVX512 static void innerProductBatchAVX512FMA(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t dim, const size_t, const size_t
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4)
+				innerProductQuadAVX512FMA(query, nodes + i, res + i, dim);
+
+			for(; i < count; i++)
+				res[i] = innerProductAVX512FMA(nodes[i], query, dim, 0, 0, 0);
+		}
+
+		FunctionInfo ipAVX512FMA(innerProductAVX512FMA, "ipAVX512FMA");
+	#endif
+
+	// Dimensions served in production get kernels of their own. The bounds are compile-time constants,
+	// so the loops unroll completely and need no tail.
+	#if defined(AVX_CAPABLE)
+		template<size_t D>
+		TARGET_AVX2 static float innerProductFixedAVX2(
+			const float* node, const float* query, const size_t,
+			const size_t, const size_t, const size_t
+		) {
+			static_assert(D % 32 == 0, "The dimension must be a multiple of 32.");
+			__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+			UNROLL_LOOP
+			for(size_t i = 0; i + 32 <= D; i += 32) {
+				sumA = _mm256_fmadd_ps(_mm256_loadu_ps(node + i), _mm256_loadu_ps(query + i), sumA);
+				sumB = _mm256_fmadd_ps(
+					_mm256_loadu_ps(node + i + 8), _mm256_loadu_ps(query + i + 8), sumB
+				);
+				sumC = _mm256_fmadd_ps(
+					_mm256_loadu_ps(node + i + 16), _mm256_loadu_ps(query + i + 16), sumC
+				);
+				sumD = _mm256_fmadd_ps(
+					_mm256_loadu_ps(node + i + 24), _mm256_loadu_ps(query + i + 24), sumD
+				);
+			}
+
+			return 1.f - reduceSum(_mm256_add_ps(_mm256_add_ps(sumA, sumB), _mm256_add_ps(sumC, sumD)));
+		}
+
+		template<size_t D>
+		TARGET_AVX2 static void innerProductBatchFixedAVX2(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t, const size_t, const size_t
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4)
+				innerProductQuadAVX2(query, nodes + i, res + i, D);
+
+			for(; i < count; i++)
+				res[i] = innerProductFixedAVX2<D>(nodes[i], query, D, 0, 0, 0);
+		}
+
+		const FixedDimKernel ipFixedAVX2[] = {
+			{
+				innerProductBatchFixedAVX2<96>, 96,
+				{innerProductFixedAVX2<96>, "ip96AVX2"}
+			},
+			{
+				innerProductBatchFixedAVX2<128>, 128,
+				{innerProductFixedAVX2<128>, "ip128AVX2"}
+			},
+			{
+				innerProductBatchFixedAVX2<256>, 256,
+				{innerProductFixedAVX2<256>, "ip256AVX2"}
+			},
+			{
+				innerProductBatchFixedAVX2<384>, 384,
+				{innerProductFixedAVX2<384>, "ip384AVX2"}
+			},
+			{
+				innerProductBatchFixedAVX2<768>, 768,
+				{innerProductFixedAVX2<768>, "ip768AVX2"}
+			},
+			{
+				innerProductBatchFixedAVX2<960>, 960,
+				{innerProductFixedAVX2<960>, "ip960AVX2"}
+			},
+			{
+				innerProductBatchFixedAVX2<1536>, 1536,
+				{innerProductFixedAVX2<1536>, "ip1536AVX2"}
+			}
+		};
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		template<size_t D>
+		TARGET_AVX512 static float innerProductFixedAVX512(
+			const float* node, const float* query, const size_t,
+			const size_t, const size_t, const size_t
+		) {
+			static_assert(D % 32 == 0, "The dimension must be a multiple of 32.");
+			__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+			UNROLL_LOOP
+			for(size_t i = 0; i + 64 <= D; i += 64) {
+				sumA = _mm512_fmadd_ps(_mm512_loadu_ps(node + i), _mm512_loadu_ps(query + i), sumA);
+				sumB = _mm512_fmadd_ps(
+					_mm512_loadu_ps(node + i + 16), _mm512_loadu_ps(query + i + 16), sumB
+				);
+				sumC = _mm512_fmadd_ps(
+					_mm512_loadu_ps(node + i + 32), _mm512_loadu_ps(query + i + 32), sumC
+				);
+				sumD = _mm512_fmadd_ps(
+					_mm512_loadu_ps(node + i + 48), _mm512_loadu_ps(query + i + 48), sumD
+				);
+			}
+
+			if constexpr(D % 64 != 0) {
+				constexpr size_t i = D - 32;
+				sumA = _mm512_fmadd_ps(_mm512_loadu_ps(node + i), _mm512_loadu_ps(query + i), sumA);
+				sumB = _mm512_fmadd_ps(
+					_mm512_loadu_ps(node + i + 16), _mm512_loadu_ps(query + i + 16), sumB
+				);
+			}
+
+			return 1.f - reduceSum(_mm512_add_ps(_mm512_add_ps(sumA, sumB), _mm512_add_ps(sumC, sumD)));
+		}
+
+		template<size_t D>
+		TARGET_AVX512 static void innerProductBatchFixedAVX512(
+			const float* query, const float* const* nodes, const size_t count, float* const res,
+			const size_t, const size_t, const size_t
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4)
+				innerProductQuadAVX512FMA(query, nodes + i, res + i, D);
+
+			for(; i < count; i++)
+				res[i] = innerProductFixedAVX512<D>(nodes[i], query, D, 0, 0, 0);
+		}
+
+		const FixedDimKernel ipFixedAVX512FMA[] = {
+			{
+				innerProductBatchFixedAVX512<96>, 96,
+				{innerProductFixedAVX512<96>, "ip96AVX512FMA"}
+			},
+			{
+				innerProductBatchFixedAVX512<128>, 128,
+				{innerProductFixedAVX512<128>, "ip128AVX512FMA"}
+			},
+			{
+				innerProductBatchFixedAVX512<256>, 256,
+				{innerProductFixedAVX512<256>, "ip256AVX512FMA"}
+			},
+			{
+				innerProductBatchFixedAVX512<384>, 384,
+				{innerProductFixedAVX512<384>, "ip384AVX512FMA"}
+			},
+			{
+				innerProductBatchFixedAVX512<768>, 768,
+				{innerProductFixedAVX512<768>, "ip768AVX512FMA"}
+			},
+			{
+				innerProductBatchFixedAVX512<960>, 960,
+				{innerProductFixedAVX512<960>, "ip960AVX512FMA"}
+			},
+			{
+				innerProductBatchFixedAVX512<1536>, 1536,
+				{innerProductFixedAVX512<1536>, "ip1536AVX512FMA"}
+			}
+		};
+	#endif
+
 	inline DistanceInfo getInnerProductInfo(
 		const size_t dim, const size_t dim4, const size_t dim16, SIMDType type
 	) {
@@ -299,6 +751,21 @@ namespace chm {
 			if(type == SIMDType::BEST)
 				type = getBestSIMDType();
 
+			checkSIMDType(type);
+
+			#if defined(AVX_CAPABLE)
+				if(type == SIMDType::AVX2) {
+					const auto fixed = findFixedDimKernel(ipFixedAVX2, dim);
+					return DistanceInfo(0, fixed ? fixed->funcInfo : ipAVX2);
+				}
+			#endif
+			#if defined(AVX512_CAPABLE)
+				if(type == SIMDType::AVX512FMA) {
+					const auto fixed = findFixedDimKernel(ipFixedAVX512FMA, dim);
+					return DistanceInfo(0, fixed ? fixed->funcInfo : ipAVX512FMA);
+				}
+			#endif
+
 			if(dim % 16 == 0)
 				switch(type) {
 					case SIMDType::AVX:
@@ -391,4 +858,207 @@ namespace chm {
 
 		return DistanceInfo(0, ip);
 	}
+
+	inline BatchDistanceFunction getInnerProductBatchFunction(const size_t dim, SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::NONE)
+				return innerProductBatch;
+
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+					#if defined(AVX_CAPABLE)
+						return innerProductBatch16AVX;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX.");
+					#endif
+				case SIMDType::AVX512:
+					#if defined(AVX512_CAPABLE)
+						return innerProductBatch16AVX512;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(const auto fixed = findFixedDimKernel(ipFixedAVX2, dim))
+							return fixed->batch;
+						return innerProductBatchAVX2;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX2 and FMA.");
+					#endif
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						if(const auto fixed = findFixedDimKernel(ipFixedAVX512FMA, dim))
+							return fixed->batch;
+						return innerProductBatchAVX512FMA;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				case SIMDType::SSE:
+					#if defined(SSE_CAPABLE)
+						return innerProductBatch4SSE;
+					#else
+						throw std::runtime_error("This CPU doesn't support SSE.");
+					#endif
+				default:
+					throw std::runtime_error("Unknown SIMD type.");
+			}
+		#endif
+
+		return innerProductBatch;
+	}
+
+	template<float (*convert)(const uint16_t)>
+	static void innerProductHalfBatch(
+		const float* query, const float*, const uint8_t* const* nodes, const size_t count,
+		float* const res, const size_t dim
+	) {
+		for(size_t i = 0; i < count; i++) {
+			const auto node = reinterpret_cast<const uint16_t*>(nodes[i]);
+			auto sum = 0.f;
+
+			for(size_t j = 0; j < dim; j++)
+				sum += convert(node[j]) * query[j];
+
+			res[i] = 1.f - sum;
+		}
+	}
+
+	#if defined(AVX_CAPABLE)
+		template<__m256 (*load)(const uint16_t*)>
+		TARGET_AVX2 static void innerProductHalfBatchAVX(
+			const float* query, const float*, const uint8_t* const* nodes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			for(size_t i = 0; i < count; i++) {
+				const auto node = reinterpret_cast<const uint16_t*>(nodes[i]);
+				__m256 sumA = _mm256_setzero_ps(), sumB = sumA;
+
+				for(size_t j = 0; j < dim; j += 16) {
+					sumA = _mm256_add_ps(sumA, _mm256_mul_ps(load(node + j), _mm256_loadu_ps(query + j)));
+					sumB = _mm256_add_ps(
+						sumB, _mm256_mul_ps(load(node + j + 8), _mm256_loadu_ps(query + j + 8))
+					);
+				}
+
+				res[i] = 1.f - horizontalSum(_mm256_add_ps(sumA, sumB));
+			}
+		}
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		template<__m512 (*load)(const uint16_t*)>
+		TARGET_AVX512 static void innerProductHalfBatchAVX512(
+			const float* query, const float*, const uint8_t* const* nodes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			for(size_t i = 0; i < count; i++) {
+				const auto node = reinterpret_cast<const uint16_t*>(nodes[i]);
+				__m512 sum = _mm512_setzero_ps();
+
+				for(size_t j = 0; j < dim; j += 16)
+					sum = _mm512_add_ps(sum, _mm512_mul_ps(load(node + j), _mm512_loadu_ps(query + j)));
+
+				res[i] = 1.f - horizontalSum(sum);
+			}
+		}
+	#endif
+
+	#if defined(AVX512_CAPABLE) && defined(AVX512_BF16_CAPABLE)
+		// The query is rounded to bfloat16 on the fly, so 32 products take one instruction.
+		TARGET_AVX512_BF16 static void innerProductBF16BatchDotAVX512(
+			const float* query, const float*, const uint8_t* const* nodes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			for(size_t i = 0; i < count; i++) {
+				const auto node = reinterpret_cast<const uint16_t*>(nodes[i]);
+				__m512 sum = _mm512_setzero_ps();
+				size_t j = 0;
+
+				for(; j + 32 <= dim; j += 32) {
+					const __m512bh q = _mm512_cvtne2ps_pbh(
+						_mm512_loadu_ps(query + j + 16), _mm512_loadu_ps(query + j)
+					);
+					__m512bh n;
+					std::memcpy(&n, node + j, sizeof(n));
+					sum = _mm512_dpbf16_ps(sum, n, q);
+				}
+
+				if(j < dim)
+					sum = _mm512_add_ps(
+						sum, _mm512_mul_ps(loadBF16x16AVX512(node + j), _mm512_loadu_ps(query + j))
+					);
+
+				res[i] = 1.f - horizontalSum(sum);
+			}
+		}
+	#endif
+
+	inline QuantizedDistanceFunction getInnerProductBF16BatchFunction(SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(getCPUFeatures().avx2)
+							return innerProductHalfBatchAVX<loadBF16x8AVX>;
+					#endif
+					break;
+				case SIMDType::AVX512:
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						#if defined(AVX512_BF16_CAPABLE)
+							if(getCPUFeatures().avx512bf16)
+								return innerProductBF16BatchDotAVX512;
+						#endif
+						return innerProductHalfBatchAVX512<loadBF16x16AVX512>;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				default:
+					break;
+			}
+		#endif
+
+		return innerProductHalfBatch<bf16ToFloat>;
+	}
+
+	inline QuantizedDistanceFunction getInnerProductFP16BatchFunction(SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(getCPUFeatures().avx2)
+							return innerProductHalfBatchAVX<loadHalf8AVX>;
+					#endif
+					break;
+				case SIMDType::AVX512:
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						return innerProductHalfBatchAVX512<loadHalf16AVX512>;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				default:
+					break;
+			}
+		#endif
+
+		return innerProductHalfBatch<halfToFloat>;
+	}
 }
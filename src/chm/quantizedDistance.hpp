@@ -0,0 +1,428 @@
+#pragma once
+#include <stdexcept>
+#include "DistanceFunction.hpp"
+
+namespace chm {
+	// Codes are compared with a prepared float query. Euclidean queries hold the offset from the
+	// minimum and use the per-dimension scale, inner product queries are premultiplied by the scale
+	// and carry one minus their dot product with the minimum after the last dimension.
+	static float euclideanDistanceSQ(
+		const float* query, const float* scale, const uint8_t* code, const size_t dim
+	) {
+		auto res = 0.f;
+
+		for(size_t i = 0; i < dim; i++) {
+			const auto diff = scale[i] * float(code[i]) - query[i];
+			res += diff * diff;
+		}
+
+		return res;
+	}
+
+	static void euclideanDistanceSQBatch(
+		const float* query, const float* scale, const uint8_t* const* codes, const size_t count,
+		float* const res, const size_t dim
+	) {
+		for(size_t i = 0; i < count; i++)
+			res[i] = euclideanDistanceSQ(query, scale, codes[i], dim);
+	}
+
+	static float innerProductSQ(const float* query, const uint8_t* code, const size_t dim) {
+		auto res = 0.f;
+
+		for(size_t i = 0; i < dim; i++)
+			res += query[i] * float(code[i]);
+
+		return query[dim] - res;
+	}
+
+	static void innerProductSQBatch(
+		const float* query, const float*, const uint8_t* const* codes, const size_t count,
+		float* const res, const size_t dim
+	) {
+		for(size_t i = 0; i < count; i++)
+			res[i] = innerProductSQ(query, codes[i], dim);
+	}
+
+	#if defined(AVX_CAPABLE)
+		TARGET_AVX2 static inline __m256 loadCodes8AVX(const uint8_t* code) {
+			const auto bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(code));
+			return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+		}
+
+		TARGET_AVX2 static float euclideanDistanceSQAVX(
+			const float* query, const float* scale, const uint8_t* code, const size_t dim
+		) {
+			__m256 sum = _mm256_setzero_ps();
+
+			for(size_t j = 0; j < dim; j += 8) {
+				const __m256 s = _mm256_loadu_ps(scale + j);
+				const __m256 diff = _mm256_sub_ps(
+					_mm256_mul_ps(s, loadCodes8AVX(code + j)), _mm256_loadu_ps(query + j)
+				);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, diff));
+			}
+
+			return horizontalSum(sum);
+		}
+
+		TARGET_AVX2 static void euclideanDistanceSQBatchAVX(
+			const float* query, const float* scale, const uint8_t* const* codes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const uint8_t* a = codes[i];
+				const uint8_t* b = codes[i + 1];
+				const uint8_t* c = codes[i + 2];
+				const uint8_t* d = codes[i + 3];
+				__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim; j += 8) {
+					const __m256 q = _mm256_loadu_ps(query + j);
+					const __m256 s = _mm256_loadu_ps(scale + j);
+					const __m256 diffA = _mm256_sub_ps(_mm256_mul_ps(s, loadCodes8AVX(a + j)), q);
+					const __m256 diffB = _mm256_sub_ps(_mm256_mul_ps(s, loadCodes8AVX(b + j)), q);
+					const __m256 diffC = _mm256_sub_ps(_mm256_mul_ps(s, loadCodes8AVX(c + j)), q);
+					const __m256 diffD = _mm256_sub_ps(_mm256_mul_ps(s, loadCodes8AVX(d + j)), q);
+					sumA = _mm256_add_ps(sumA, _mm256_mul_ps(diffA, diffA));
+					sumB = _mm256_add_ps(sumB, _mm256_mul_ps(diffB, diffB));
+					sumC = _mm256_add_ps(sumC, _mm256_mul_ps(diffC, diffC));
+					sumD = _mm256_add_ps(sumD, _mm256_mul_ps(diffD, diffD));
+				}
+
+				res[i] = horizontalSum(sumA);
+				res[i + 1] = horizontalSum(sumB);
+				res[i + 2] = horizontalSum(sumC);
+				res[i + 3] = horizontalSum(sumD);
+			}
+
+			for(; i < count; i++)
+				res[i] = euclideanDistanceSQAVX(query, scale, codes[i], dim);
+		}
+
+		TARGET_AVX2 static float innerProductSQAVX(const float* query, const uint8_t* code, const size_t dim) {
+			__m256 sum = _mm256_setzero_ps();
+
+			for(size_t j = 0; j < dim; j += 8)
+				sum = _mm256_add_ps(
+					sum, _mm256_mul_ps(_mm256_loadu_ps(query + j), loadCodes8AVX(code + j))
+				);
+
+			return query[dim] - horizontalSum(sum);
+		}
+
+		TARGET_AVX2 static void innerProductSQBatchAVX(
+			const float* query, const float*, const uint8_t* const* codes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const uint8_t* a = codes[i];
+				const uint8_t* b = codes[i + 1];
+				const uint8_t* c = codes[i + 2];
+				const uint8_t* d = codes[i + 3];
+				__m256 sumA = _mm256_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim; j += 8) {
+					const __m256 q = _mm256_loadu_ps(query + j);
+					sumA = _mm256_add_ps(sumA, _mm256_mul_ps(q, loadCodes8AVX(a + j)));
+					sumB = _mm256_add_ps(sumB, _mm256_mul_ps(q, loadCodes8AVX(b + j)));
+					sumC = _mm256_add_ps(sumC, _mm256_mul_ps(q, loadCodes8AVX(c + j)));
+					sumD = _mm256_add_ps(sumD, _mm256_mul_ps(q, loadCodes8AVX(d + j)));
+				}
+
+				res[i] = query[dim] - horizontalSum(sumA);
+				res[i + 1] = query[dim] - horizontalSum(sumB);
+				res[i + 2] = query[dim] - horizontalSum(sumC);
+				res[i + 3] = query[dim] - horizontalSum(sumD);
+			}
+
+			for(; i < count; i++)
+				res[i] = innerProductSQAVX(query, codes[i], dim);
+		}
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		TARGET_AVX512 static inline __m512 loadCodes16AVX512(const uint8_t* code) {
+			// The zero-masked forms compile to the same instructions, but GCC doesn't warn about an
+			// uninitialized source inside them.
+			const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code));
+			const auto all = __mmask16(0xFFFF);
+			return _mm512_maskz_cvtepi32_ps(all, _mm512_maskz_cvtepu8_epi32(all, bytes));
+		}
+
+		TARGET_AVX512 static float euclideanDistanceSQAVX512(
+			const float* query, const float* scale, const uint8_t* code, const size_t dim
+		) {
+			__m512 sum = _mm512_setzero_ps();
+
+			for(size_t j = 0; j < dim; j += 16) {
+				const __m512 s = _mm512_loadu_ps(scale + j);
+				const __m512 diff = _mm512_sub_ps(
+					_mm512_mul_ps(s, loadCodes16AVX512(code + j)), _mm512_loadu_ps(query + j)
+				);
+				sum = _mm512_add_ps(sum, _mm512_mul_ps(diff, diff));
+			}
+
+			return horizontalSum(sum);
+		}
+
+		TARGET_AVX512 static void euclideanDistanceSQBatchAVX512(
+			const float* query, const float* scale, const uint8_t* const* codes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const uint8_t* a = codes[i];
+				const uint8_t* b = codes[i + 1];
+				const uint8_t* c = codes[i + 2];
+				const uint8_t* d = codes[i + 3];
+				__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim; j += 16) {
+					const __m512 q = _mm512_loadu_ps(query + j);
+					const __m512 s = _mm512_loadu_ps(scale + j);
+					const __m512 diffA = _mm512_sub_ps(_mm512_mul_ps(s, loadCodes16AVX512(a + j)), q);
+					const __m512 diffB = _mm512_sub_ps(_mm512_mul_ps(s, loadCodes16AVX512(b + j)), q);
+					const __m512 diffC = _mm512_sub_ps(_mm512_mul_ps(s, loadCodes16AVX512(c + j)), q);
+					const __m512 diffD = _mm512_sub_ps(_mm512_mul_ps(s, loadCodes16AVX512(d + j)), q);
+					sumA = _mm512_add_ps(sumA, _mm512_mul_ps(diffA, diffA));
+					sumB = _mm512_add_ps(sumB, _mm512_mul_ps(diffB, diffB));
+					sumC = _mm512_add_ps(sumC, _mm512_mul_ps(diffC, diffC));
+					sumD = _mm512_add_ps(sumD, _mm512_mul_ps(diffD, diffD));
+				}
+
+				res[i] = horizontalSum(sumA);
+				res[i + 1] = horizontalSum(sumB);
+				res[i + 2] = horizontalSum(sumC);
+				res[i + 3] = horizontalSum(sumD);
+			}
+
+			for(; i < count; i++)
+				res[i] = euclideanDistanceSQAVX512(query, scale, codes[i], dim);
+		}
+
+		TARGET_AVX512 static float innerProductSQAVX512(const float* query, const uint8_t* code, const size_t dim) {
+			__m512 sum = _mm512_setzero_ps();
+
+			for(size_t j = 0; j < dim; j += 16)
+				sum = _mm512_add_ps(
+					sum, _mm512_mul_ps(_mm512_loadu_ps(query + j), loadCodes16AVX512(code + j))
+				);
+
+			return query[dim] - horizontalSum(sum);
+		}
+
+		TARGET_AVX512 static void innerProductSQBatchAVX512(
+			const float* query, const float*, const uint8_t* const* codes, const size_t count,
+			float* const res, const size_t dim
+		) {
+			size_t i = 0;
+
+			for(; i + 4 <= count; i += 4) {
+				const uint8_t* a = codes[i];
+				const uint8_t* b = codes[i + 1];
+				const uint8_t* c = codes[i + 2];
+				const uint8_t* d = codes[i + 3];
+				__m512 sumA = _mm512_setzero_ps(), sumB = sumA, sumC = sumA, sumD = sumA;
+
+				for(size_t j = 0; j < dim; j += 16) {
+					const __m512 q = _mm512_loadu_ps(query + j);
+					sumA = _mm512_add_ps(sumA, _mm512_mul_ps(q, loadCodes16AVX512(a + j)));
+					sumB = _mm512_add_ps(sumB, _mm512_mul_ps(q, loadCodes16AVX512(b + j)));
+					sumC = _mm512_add_ps(sumC, _mm512_mul_ps(q, loadCodes16AVX512(c + j)));
+					sumD = _mm512_add_ps(sumD, _mm512_mul_ps(q, loadCodes16AVX512(d + j)));
+				}
+
+				res[i] = query[dim] - horizontalSum(sumA);
+				res[i + 1] = query[dim] - horizontalSum(sumB);
+				res[i + 2] = query[dim] - horizontalSum(sumC);
+				res[i + 3] = query[dim] - horizontalSum(sumD);
+			}
+
+			for(; i < count; i++)
+				res[i] = innerProductSQAVX512(query, codes[i], dim);
+		}
+	#endif
+
+	// Product codes index a table of per-subspace distances built for the query, which holds
+	// 256 entries per subspace followed by a constant added to every distance.
+	static float distancePQ(const float* table, const uint8_t* code, const size_t subspaceCount) {
+		auto res = table[subspaceCount << 8];
+
+		for(size_t m = 0; m < subspaceCount; m++)
+			res += table[(m << 8) + code[m]];
+
+		return res;
+	}
+
+	static void distancePQBatch(
+		const float* table, const float*, const uint8_t* const* codes, const size_t count,
+		float* const res, const size_t subspaceCount
+	) {
+		for(size_t i = 0; i < count; i++)
+			res[i] = distancePQ(table, codes[i], subspaceCount);
+	}
+
+	#if defined(AVX_CAPABLE)
+		TARGET_AVX2 static float distancePQAVX(const float* table, const uint8_t* code, const size_t subspaceCount) {
+			const __m256i offsets = _mm256_setr_epi32(0, 256, 512, 768, 1024, 1280, 1536, 1792);
+			__m256 sum = _mm256_setzero_ps();
+			size_t m = 0;
+
+			for(; m + 8 <= subspaceCount; m += 8) {
+				const auto bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(code + m));
+				const __m256i idx = _mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), offsets);
+				sum = _mm256_add_ps(sum, _mm256_i32gather_ps(table + (m << 8), idx, 4));
+			}
+
+			auto res = table[subspaceCount << 8] + horizontalSum(sum);
+
+			for(; m < subspaceCount; m++)
+				res += table[(m << 8) + code[m]];
+
+			return res;
+		}
+
+		TARGET_AVX2 static void distancePQBatchAVX(
+			const float* table, const float*, const uint8_t* const* codes, const size_t count,
+			float* const res, const size_t subspaceCount
+		) {
+			for(size_t i = 0; i < count; i++)
+				res[i] = distancePQAVX(table, codes[i], subspaceCount);
+		}
+	#endif
+
+	#if defined(AVX512_CAPABLE)
+		TARGET_AVX512 static float distancePQAVX512(
+			const float* table, const uint8_t* code, const size_t subspaceCount
+		) {
+			const __m512i offsets = _mm512_mullo_epi32(
+				_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+				_mm512_set1_epi32(256)
+			);
+			__m512 sum = _mm512_setzero_ps();
+			size_t m = 0;
+
+			for(; m + 16 <= subspaceCount; m += 16) {
+				const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + m));
+				const auto all = __mmask16(0xFFFF);
+				const __m512i idx = _mm512_add_epi32(_mm512_maskz_cvtepu8_epi32(all, bytes), offsets);
+				const __m512 gathered = _mm512_mask_i32gather_ps(
+					_mm512_setzero_ps(), all, idx, table + (m << 8), 4
+				);
+				sum = _mm512_add_ps(sum, gathered);
+			}
+
+			auto res = table[subspaceCount << 8] + horizontalSum(sum);
+
+			for(; m < subspaceCount; m++)
+				res += table[(m << 8) + code[m]];
+
+			return res;
+		}
+
+		TARGET_AVX512 static void distancePQBatchAVX512(
+			const float* table, const float*, const uint8_t* const* codes, const size_t count,
+			float* const res, const size_t subspaceCount
+		) {
+			for(size_t i = 0; i < count; i++)
+				res[i] = distancePQAVX512(table, codes[i], subspaceCount);
+		}
+	#endif
+
+	inline QuantizedDistanceFunction getPQBatchFunction(SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(getCPUFeatures().avx2)
+							return distancePQBatchAVX;
+					#endif
+					break;
+				case SIMDType::AVX512:
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						return distancePQBatchAVX512;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				default:
+					break;
+			}
+		#endif
+
+		return distancePQBatch;
+	}
+
+	// SSE and AVX without AVX2 can't widen bytes in registers, so they use the scalar kernels.
+	inline QuantizedDistanceFunction getEuclideanSQBatchFunction(SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(getCPUFeatures().avx2)
+							return euclideanDistanceSQBatchAVX;
+					#endif
+					break;
+				case SIMDType::AVX512:
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						return euclideanDistanceSQBatchAVX512;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				default:
+					break;
+			}
+		#endif
+
+		return euclideanDistanceSQBatch;
+	}
+
+	inline QuantizedDistanceFunction getInnerProductSQBatchFunction(SIMDType type) {
+		#if defined(SIMD_CAPABLE)
+			if(type == SIMDType::BEST)
+				type = getBestSIMDType();
+
+			checkSIMDType(type);
+
+			switch(type) {
+				case SIMDType::AVX:
+				case SIMDType::AVX2:
+					#if defined(AVX_CAPABLE)
+						if(getCPUFeatures().avx2)
+							return innerProductSQBatchAVX;
+					#endif
+					break;
+				case SIMDType::AVX512:
+				case SIMDType::AVX512FMA:
+					#if defined(AVX512_CAPABLE)
+						return innerProductSQBatchAVX512;
+					#else
+						throw std::runtime_error("This CPU doesn't support AVX512.");
+					#endif
+				default:
+					break;
+			}
+		#endif
+
+		return innerProductSQBatch;
+	}
+}
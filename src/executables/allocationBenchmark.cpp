@@ -0,0 +1,85 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	std::atomic<size_t> allocationCount(0);
+}
+
+void* operator new(std::size_t size) {
+	allocationCount++;
+
+	if(auto p = std::malloc(size ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+// GCC treats memory from operator new as never reaching free, even when operator new is replaced.
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 32;
+		constexpr size_t queryCount = 1000;
+		constexpr size_t trainCount = 20000;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const IndexConfig cfg(200, 16, uint(trainCount));
+		SequentialIndex index(cfg, dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+		index.push(ArrayView<const float>(train.data(), dim, trainCount));
+
+		const auto ctx = index.contextPool.acquire();
+		std::cout << index.getString() << '\n';
+		printField("EfSearch", std::cout, 8);
+		printField("Allocations per query", std::cout, 24);
+		printField("\n", std::cout, 1);
+
+		for(const uint efSearch : {10, 40, 120, 500}) {
+			const auto before = allocationCount.load();
+
+			for(size_t i = 0; i < queryCount; i++)
+				(void)index.query(test.data() + i * dim, efSearch, 10, *ctx);
+
+			printField(efSearch, std::cout, 8);
+			std::cout << std::right << std::setw(24);
+			print(float(allocationCount.load() - before) / float(queryCount), std::cout);
+			printField("\n", std::cout, 1);
+		}
+
+		index.contextPool.release(ctx);
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
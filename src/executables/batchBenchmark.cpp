@@ -0,0 +1,63 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 32;
+		constexpr size_t queryCount = 4096;
+		constexpr size_t trainCount = 10000;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		ParallelIndex index(
+			IndexConfig(100, 16, uint(trainCount)), dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST
+		);
+		index.push(ArrayView<const float>(train.data(), dim, trainCount));
+
+		printField("Workers", std::cout, 8);
+		printField("Batch", std::cout, 6);
+		printField("Microseconds per batch", std::cout, 24);
+		printField("Microseconds per query", std::cout, 24);
+		printField("\n", std::cout, 1);
+
+		for(const size_t workers : {1, 4}) {
+			index.setWorkersNum(workers);
+
+			for(const size_t batch : {1, 16, 256}) {
+				const auto batchCount = queryCount / batch;
+				Timer timer{};
+
+				for(size_t i = 0; i < batchCount; i++)
+					(void)index.queryBatch(
+						ArrayView<const float>(test.data() + i * batch * dim, dim, batch), 10, 10
+					);
+
+				const auto elapsed = chr::duration<float, std::micro>(timer.getElapsed()).count();
+				printField(workers, std::cout, 8);
+				printField(batch, std::cout, 6);
+				std::cout << std::right << std::setw(24);
+				print(elapsed / float(batchCount), std::cout);
+				std::cout << std::right << std::setw(24);
+				print(elapsed / float(queryCount), std::cout);
+				printField("\n", std::cout, 1);
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -28,7 +28,9 @@ namespace chm {
 
 		py::enum_<SIMDType>(m, "SIMDType")
 			.value("AVX", SIMDType::AVX)
+			.value("AVX2", SIMDType::AVX2)
 			.value("AVX512", SIMDType::AVX512)
+			.value("AVX512FMA", SIMDType::AVX512FMA)
 			.value("BEST", SIMDType::BEST)
 			.value("NONE", SIMDType::NONE)
 			.value("SSE", SIMDType::SSE);
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	struct BudgetMode {
+		std::string name;
+		chm::SearchBudget budget;
+	};
+
+	float getPercentile(std::vector<float> v, const float p) {
+		const auto idx = std::min(size_t(p * float(v.size())), v.size() - 1);
+		std::nth_element(v.begin(), v.begin() + idx, v.end());
+		return v[idx];
+	}
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 64;
+		constexpr uint efSearch = 200;
+		constexpr uint k = 10;
+		constexpr size_t queryCount = 2000;
+		constexpr size_t trainCount = 30000;
+		const std::vector<BudgetMode> modes{
+			{"none", SearchBudget()},
+			{"dist 2000", SearchBudget(2000)},
+			{"dist 4000", SearchBudget(4000)},
+			{"hops 100", SearchBudget(0, 100)},
+			{"hops 200", SearchBudget(0, 200)},
+			{"time 100us", SearchBudget(0, 0, chr::microseconds(100))},
+			{"time 200us", SearchBudget(0, 0, chr::microseconds(200))},
+			{"patience 10", SearchBudget(0, 0, chr::nanoseconds(0), 10)},
+			{"patience 20", SearchBudget(0, 0, chr::nanoseconds(0), 20)},
+			{"patience 40", SearchBudget(0, 0, chr::nanoseconds(0), 40)}
+		};
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+		BruteforceIndex bruteforce(dim, trainCount, SIMDType::BEST, SpaceKind::EUCLIDEAN);
+		bruteforce.push(trainView);
+		const auto correct = bruteforce.queryBatch(testView, k);
+
+		SequentialIndex index(
+			IndexConfig(100, 16, uint(trainCount)), dim, 100, SpaceKind::EUCLIDEAN, SIMDType::BEST
+		);
+		index.push(trainView);
+		const auto ctx = index.contextPool.acquire();
+
+		printField("Budget", std::cout, 13);
+		printField("Mean us", std::cout, 9);
+		printField("p50 us", std::cout, 9);
+		printField("p99 us", std::cout, 9);
+		printField("Max us", std::cout, 9);
+		printField("Recall", std::cout, 8);
+		printField("\n", std::cout, 1);
+
+		for(const auto& mode : modes) {
+			QueryResults found(k, queryCount);
+			std::vector<float> latencies(queryCount);
+			index.setSearchBudget(mode.budget);
+
+			for(size_t i = 0; i < queryCount; i++) {
+				Timer timer{};
+				const auto& W = index.query(testView.getData(i), efSearch, k, *ctx);
+				latencies[i] = chr::duration<float, std::micro>(timer.getElapsed()).count();
+				found.push(W, i);
+			}
+
+			float mean = 0.f;
+
+			for(const auto l : latencies)
+				mean += l;
+
+			printField(mode.name, std::cout, 13);
+			std::cout << std::right << std::setw(9);
+			print(mean / float(queryCount), std::cout, 1);
+			std::cout << std::right << std::setw(9);
+			print(getPercentile(latencies, 0.5f), std::cout, 1);
+			std::cout << std::right << std::setw(9);
+			print(getPercentile(latencies, 0.99f), std::cout, 1);
+			std::cout << std::right << std::setw(9);
+			print(*std::max_element(latencies.begin(), latencies.end()), std::cout, 1);
+			std::cout << std::right << std::setw(8);
+			print(getRecall(correct->getIDs(), found.getIDs()), std::cout, 3);
+			printField("\n", std::cout, 1);
+		}
+
+		index.contextPool.release(ctx);
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
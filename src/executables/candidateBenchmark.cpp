@@ -0,0 +1,150 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+namespace chm {
+	constexpr uint fanOut = 32;
+	constexpr size_t searchCount = 2000;
+
+	// Neighbor distances are drawn independently, so every search ends after expanding
+	// a few times ef candidates and all structures see the same sequence.
+	class DistanceStream {
+		std::vector<float> dists;
+		size_t pos;
+
+	public:
+		DistanceStream(const size_t len, const uint seed);
+		float next();
+		void reset();
+	};
+
+	DistanceStream::DistanceStream(const size_t len, const uint seed) : dists(len), pos(0) {
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(seed);
+
+		for(auto& d : this->dists)
+			d = dist(gen);
+	}
+
+	float DistanceStream::next() {
+		const auto res = this->dists[this->pos];
+		this->pos = (this->pos + 1) % this->dists.size();
+		return res;
+	}
+
+	void DistanceStream::reset() {
+		this->pos = 0;
+	}
+
+	static uint64_t searchHeap(const uint ef, DistanceStream& s) {
+		uint nextID = 0;
+		const Node ep(s.next(), nextID++);
+		NearHeap C(ep);
+		FarHeap W(ep);
+
+		while(C.len()) {
+			const auto c = C.extractTop();
+
+			if(W.len() == ef && c.dist > W.top().dist)
+				break;
+
+			for(uint i = 0; i < fanOut; i++) {
+				const Node e(s.next(), nextID++);
+
+				if(W.len() < ef || W.top().dist > e.dist) {
+					C.push(e);
+					W.push(e);
+
+					if(W.len() > ef)
+						W.pop();
+				}
+			}
+		}
+
+		uint64_t res = 0;
+
+		while(W.len())
+			res += W.extractTop().id;
+
+		return res;
+	}
+
+	template<class Entry>
+	static uint64_t searchSorted(const uint ef, DistanceStream& s, SortedBuffer<Entry>& W) {
+		uint nextID = 0;
+		W.reset(ef);
+		W.push(s.next(), nextID++);
+
+		while(W.hasNext()) {
+			(void)W.extractNext();
+
+			for(uint i = 0; i < fanOut; i++)
+				W.push(s.next(), nextID++);
+		}
+
+		uint64_t res = 0;
+
+		for(uint i = 0; i < W.len(); i++)
+			res += W.get(i).id;
+
+		return res;
+	}
+
+	template<class Search>
+	static float measure(DistanceStream& s, uint64_t& checksum, Search search) {
+		s.reset();
+		checksum = 0;
+		Timer timer{};
+
+		for(size_t i = 0; i < searchCount; i++)
+			checksum += search();
+
+		return float(searchCount) / chr::duration<float>(timer.getElapsed()).count();
+	}
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		DistanceStream s(1 << 20, 104);
+		SortedBuffer<Node> nodeBuffer(1);
+		SortedBuffer<PackedNode> packedBuffer(1);
+
+		std::cout << "Searches per second, fan-out " << fanOut << '\n';
+		printField("EfSearch", std::cout, 8);
+		printField("Heap", std::cout, 12);
+		printField("Sorted", std::cout, 12);
+		printField("Packed", std::cout, 12);
+		printField("Same results", std::cout, 14);
+		printField("\n", std::cout, 1);
+
+		for(const uint ef : {10, 40, 100, 200, 500}) {
+			uint64_t heapSum, nodeSum, packedSum;
+			const auto heap = measure(s, heapSum, [&]() { return searchHeap(ef, s); });
+			const auto sorted = measure(
+				s, nodeSum, [&]() { return searchSorted(ef, s, nodeBuffer); }
+			);
+			const auto packed = measure(
+				s, packedSum, [&]() { return searchSorted(ef, s, packedBuffer); }
+			);
+
+			printField(ef, std::cout, 8);
+			std::cout << std::right << std::setw(12);
+			print(heap, std::cout);
+			std::cout << std::right << std::setw(12);
+			print(sorted, std::cout);
+			std::cout << std::right << std::setw(12);
+			print(packed, std::cout);
+			printField(heapSum == nodeSum && heapSum == packedSum ? "yes" : "no", std::cout, 14);
+			printField("\n", std::cout, 1);
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 32;
+		constexpr size_t hours = 8;
+		constexpr size_t queryCount = 1000;
+		constexpr size_t trainCount = 20000;
+		constexpr size_t replacedCount = trainCount / 10;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<uint> ids(trainCount);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		std::iota(ids.begin(), ids.end(), uint(0));
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+
+		ParallelIndex index(
+			IndexConfig(100, 16, uint(trainCount)), dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST
+		);
+		index.push(ArrayView<const float>(train.data(), dim, trainCount));
+
+		printField("Hour", std::cout, 6);
+		printField("Replaced", std::cout, 10);
+		printField("Insert seconds", std::cout, 16);
+		printField("QPS", std::cout, 10);
+		printField("Recall", std::cout, 8);
+		printField("\n", std::cout, 1);
+
+		for(size_t hour = 0; hour <= hours; hour++) {
+			float insertElapsed = 0.f;
+
+			// Each hour retires a tenth of the vectors and fills their slots with fresh ones.
+			if(hour) {
+				std::shuffle(ids.begin(), ids.end(), gen);
+
+				for(size_t i = 0; i < replacedCount; i++)
+					index.markDeleted(ids[i]);
+
+				std::vector<float> fresh(dim * replacedCount);
+
+				for(auto& f : fresh)
+					f = dist(gen);
+
+				Timer timer{};
+				const auto reused = index.insert(
+					ArrayView<const float>(fresh.data(), dim, replacedCount)
+				);
+				insertElapsed = chr::duration<float>(timer.getElapsed()).count();
+
+				for(size_t i = 0; i < replacedCount; i++)
+					std::copy(
+						fresh.begin() + i * dim, fresh.begin() + (i + 1) * dim,
+						train.begin() + reused[i] * dim
+					);
+			}
+
+			BruteforceIndex bruteforce(dim, trainCount, SIMDType::BEST, SpaceKind::EUCLIDEAN);
+			bruteforce.push(ArrayView<const float>(train.data(), dim, trainCount));
+			const auto correct = bruteforce.queryBatch(testView, 10);
+
+			Timer timer{};
+			const auto found = index.queryBatch(testView, 100, 10);
+			const auto queryElapsed = chr::duration<float>(timer.getElapsed()).count();
+
+			printField(hour, std::cout, 6);
+			printField(hour ? replacedCount : 0, std::cout, 10);
+			std::cout << std::right << std::setw(16);
+			print(insertElapsed, std::cout, 3);
+			std::cout << std::right << std::setw(10);
+			print(float(queryCount) / queryElapsed, std::cout, 1);
+			std::cout << std::right << std::setw(8);
+			print(getRecall(correct->getIDs(), found->getIDs()), std::cout, 3);
+			printField("\n", std::cout, 1);
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	struct DispatchConfig {
+		chm::ChunkPolicy policy;
+		size_t chunkSize;
+	};
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 32;
+		constexpr size_t queryCount = 20000;
+		constexpr size_t trainCount = 20000;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const IndexConfig cfg(200, 16, uint(trainCount));
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+		const DispatchConfig dispatchConfigs[] = {
+			{ChunkPolicy::FIXED, 1},
+			{ChunkPolicy::FIXED, 16},
+			{ChunkPolicy::FIXED, 256},
+			{ChunkPolicy::GUIDED, 1},
+			{ChunkPolicy::GUIDED, 16}
+		};
+
+		printField("Chunks", std::cout, 8);
+		printField("Size", std::cout, 6);
+		printField("Workers", std::cout, 8);
+		printField("Elements per second", std::cout, 21);
+		printField("Queries per second", std::cout, 20);
+		printField("\n", std::cout, 1);
+
+		for(const auto& c : dispatchConfigs)
+			for(const size_t workers : {1, 2, 4, 8, 16, 32, 64}) {
+				ParallelIndex index(cfg, dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+				index.setChunkPolicy(c.policy, c.chunkSize);
+				index.setWorkersNum(workers);
+
+				Timer timer{};
+				index.push(trainView);
+				const auto buildElapsed = chr::duration<float>(timer.getElapsed()).count();
+
+				timer.reset();
+				(void)index.queryBatch(testView, 10, 10);
+				const auto queryElapsed = chr::duration<float>(timer.getElapsed()).count();
+
+				printField(chunkPolicyToStr(c.policy), std::cout, 8);
+				printField(c.chunkSize, std::cout, 6);
+				printField(workers, std::cout, 8);
+				std::cout << std::right << std::setw(21);
+				print(float(trainCount) / buildElapsed, std::cout);
+				std::cout << std::right << std::setw(20);
+				print(float(queryCount) / queryElapsed, std::cout);
+				printField("\n", std::cout, 1);
+			}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
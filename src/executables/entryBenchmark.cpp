@@ -0,0 +1,53 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 32;
+		constexpr size_t trainCount = 20000;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+		printField("mL", std::cout, 6);
+		printField("Workers", std::cout, 8);
+		printField("Top level", std::cout, 10);
+		printField("Elements per second", std::cout, 21);
+		printField("\n", std::cout, 1);
+
+		// A large level multiplier keeps raising the top level, which used to serialize the build.
+		for(const double mL : {0.0, 1.0, 2.0, 4.0})
+			for(const size_t workers : {1, 4, 16}) {
+				const IndexConfig cfg(100, 16, uint(trainCount), StorageLayout::SPLIT, mL);
+				ParallelIndex index(cfg, dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+				index.setWorkersNum(workers);
+
+				Timer timer{};
+				index.push(trainView);
+				const auto elapsed = chr::duration<float>(timer.getElapsed()).count();
+
+				std::cout << std::right << std::setw(6);
+				print(float(cfg.getML()), std::cout);
+				printField(workers, std::cout, 8);
+				printField(index.getEntryLevel(), std::cout, 10);
+				std::cout << std::right << std::setw(21);
+				print(float(trainCount) / elapsed, std::cout);
+				printField("\n", std::cout, 1);
+			}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 25;
+		constexpr uint efSearch = 100;
+		constexpr uint k = 10;
+		constexpr size_t queryCount = 1000;
+		constexpr size_t trainCount = 50000;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+		SequentialIndex index(
+			IndexConfig(200, 16, uint(trainCount)), dim, 100, SpaceKind::EUCLIDEAN, SIMDType::BEST
+		);
+		index.push(trainView);
+
+		printField("Selectivity", std::cout, 13);
+		printField("Allowed", std::cout, 9);
+		printField("Mode", std::cout, 12);
+		printField("QPS", std::cout, 10);
+		printField("Recall", std::cout, 8);
+		printField("Missing", std::cout, 9);
+		printField("\n", std::cout, 1);
+
+		// The smallest selectivity allows fewer than k elements, so every result is padded.
+		for(const auto selectivity : {0.0001, 0.01, 0.1, 0.5}) {
+			std::bernoulli_distribution allowDist(selectivity);
+			const std::vector<IDFilter> filters{
+				IDFilter(trainCount, [&](const uint) { return allowDist(gen); })
+			};
+
+			// The scan is exact, so its results are the ground truth.
+			index.setFilterMode(FilterMode::BRUTEFORCE);
+			const auto correct = index.queryBatch(testView, efSearch, k, filters);
+
+			for(const auto mode : {FilterMode::BRUTEFORCE, FilterMode::GRAPH, FilterMode::AUTO}) {
+				index.setFilterMode(mode);
+
+				Timer timer{};
+				const auto found = index.queryBatch(testView, efSearch, k, filters);
+				const auto elapsed = chr::duration<float>(timer.getElapsed()).count();
+				const auto ids = found->getIDs();
+				size_t missing = 0;
+
+				for(size_t queryIdx = 0; queryIdx < queryCount; queryIdx++)
+					for(size_t neighborIdx = 0; neighborIdx < k; neighborIdx++)
+						if(ids.getVal(queryIdx, neighborIdx) == QueryResults::missingID)
+							missing++;
+
+				std::cout << std::right << std::setw(13);
+				print(float(selectivity), std::cout, 2);
+				printField(filters.front().getAllowedCount(), std::cout, 9);
+				printField(filterModeToStr(mode), std::cout, 12);
+				std::cout << std::right << std::setw(10);
+				print(float(queryCount) / elapsed, std::cout, 1);
+				std::cout << std::right << std::setw(8);
+				print(getRecall(correct->getIDs(), ids), std::cout, 3);
+				std::cout << std::right << std::setw(9);
+				print(float(missing) / float(queryCount), std::cout, 2);
+				printField("\n", std::cout, 1);
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "chm/Benchmark.hpp"
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t batchCount = 1000000;
+		constexpr size_t dim = 32;
+		constexpr size_t finalCount = 10000000;
+		const auto workers = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+		std::vector<float> batch(dim * batchCount);
+		const ArrayView<const float> batchView(batch.data(), dim, batchCount);
+
+		printField("Initial capacity", std::cout, 18);
+		printField("Elements", std::cout, 10);
+		printField("Capacity", std::cout, 10);
+		printField("Batch elements per second", std::cout, 27);
+		printField("Amortized elements per second", std::cout, 31);
+		printField("\n", std::cout, 1);
+
+		// An index sized for everything up front is the baseline for the one that keeps growing.
+		for(const size_t initialCount : {batchCount, finalCount}) {
+			const IndexConfig cfg(100, 16, uint(initialCount));
+			ParallelIndex index(cfg, dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+			std::uniform_real_distribution<float> dist{};
+			std::default_random_engine gen(104);
+			float totalElapsed = 0.f;
+			index.setWorkersNum(workers);
+
+			for(size_t elemCount = batchCount; elemCount <= finalCount; elemCount += batchCount) {
+				for(auto& f : batch)
+					f = dist(gen);
+
+				Timer timer{};
+				index.push(batchView);
+				const auto elapsed = chr::duration<float>(timer.getElapsed()).count();
+				totalElapsed += elapsed;
+
+				printField(initialCount, std::cout, 18);
+				printField(elemCount, std::cout, 10);
+				printField(index.getCapacity(), std::cout, 10);
+				std::cout << std::right << std::setw(27);
+				print(float(batchCount) / elapsed, std::cout);
+				std::cout << std::right << std::setw(31);
+				print(float(elemCount) / totalElapsed, std::cout);
+				printField("\n", std::cout, 1);
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
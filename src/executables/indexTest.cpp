@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include "chm/Index.hpp"
+
+namespace {
+	using namespace chm;
+
+	struct StorageCase {
+		bool rerank;
+		VectorStorage storage;
+		uint subspaces;
+	};
+
+	void check(const bool condition, const std::string& msg) {
+		if(!condition)
+			throw std::runtime_error(msg);
+	}
+
+	std::vector<float> getRandomVectors(const size_t dim, const size_t count, const unsigned seed) {
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(seed);
+		std::vector<float> res(dim * count);
+
+		for(auto& f : res)
+			f = dist(gen);
+
+		return res;
+	}
+
+	// The deleted entry keeps routing searches with its old vector, so its slot is never refilled.
+	template<class I>
+	void testDeletedEntry(const std::string& name) {
+		constexpr size_t dim = 16;
+		constexpr size_t elemCount = 1000;
+		constexpr size_t replacedCount = 100;
+		const auto train = getRandomVectors(dim, elemCount, 104);
+		const auto fresh = getRandomVectors(dim, replacedCount, 105);
+
+		I index(IndexConfig(100, 16, uint(elemCount)), dim, 100, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+		index.push(ArrayView<const float>(train.data(), dim, elemCount));
+		const auto entryID = index.getEntryID();
+		index.markDeleted(entryID);
+
+		for(uint id = 0; index.getDeletedCount() < replacedCount; id += 7)
+			index.markDeleted(id);
+
+		const ArrayView<const float> freshView(fresh.data(), dim, replacedCount);
+		const auto ids = index.insert(freshView);
+
+		check(index.getEntryID() == entryID, name + " moved the entry point.");
+		check(index.isDeleted(entryID), name + " refilled the deleted entry slot.");
+		check(
+			std::find(ids.begin(), ids.end(), entryID) == ids.end(),
+			name + " returned the entry slot for a new vector."
+		);
+		check(ids.back() == uint(elemCount), name + " did not append the vector left over.");
+
+		const auto found = index.queryBatch(freshView, 50, 1);
+		size_t foundCount = 0;
+
+		for(size_t i = 0; i < replacedCount; i++)
+			if(found->getID(i, 0) == ids[i])
+				foundCount++;
+
+		check(foundCount >= replacedCount * 9 / 10, name + " lost new vectors after the entry died.");
+	}
+
+	// Float rows exist only for float storage or reranking, quantized codes replace them otherwise.
+	void testStorageAllocation() {
+		constexpr size_t dim = 32;
+		constexpr size_t elemCount = 2000;
+		const std::vector<StorageCase> cases{
+			{false, VectorStorage::FLOAT, 0},
+			{false, VectorStorage::INT8, 0},
+			{true, VectorStorage::INT8, 0},
+			{false, VectorStorage::PQ, 8},
+			{true, VectorStorage::PQ, 8},
+			{false, VectorStorage::FP16, 0},
+			{false, VectorStorage::BF16, 0}
+		};
+		const auto train = getRandomVectors(dim, elemCount, 104);
+
+		for(const auto& c : cases) {
+			const IndexConfig cfg(
+				100, 16, uint(elemCount), StorageLayout::SPLIT, 0.0, c.storage, c.rerank, c.subspaces
+			);
+			SequentialIndex index(cfg, dim, 100, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+			index.push(ArrayView<const float>(train.data(), dim, elemCount));
+
+			const auto name = vectorStorageToStr(c.storage) + (c.rerank ? " with rerank" : "");
+			const auto& space = index.space;
+
+			check(
+				(space.getFloatCapacity() != 0) == space.hasFloats(),
+				name + " reserves float rows that do not match its storage."
+			);
+			check(
+				space.getAllocatedBytes() == space.getCapacity() * space.getVectorBytes(),
+				name + " allocates more than its vectors need."
+			);
+		}
+	}
+}
+
+int main() {
+	try {
+		testStorageAllocation();
+		testDeletedEntry<SequentialIndex>("Sequential index");
+		testDeletedEntry<ParallelIndex>("Parallel index");
+		std::cout << "All tests passed.\n";
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
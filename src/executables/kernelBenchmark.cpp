@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	std::vector<chm::SIMDType> getAvailableSIMD() {
+		using chm::SIMDType;
+		const auto& cpu = chm::getCPUFeatures();
+		std::vector<SIMDType> res{SIMDType::NONE};
+
+		if(cpu.sse)
+			res.push_back(SIMDType::SSE);
+		if(cpu.avx)
+			res.push_back(SIMDType::AVX);
+		if(cpu.avx2)
+			res.push_back(SIMDType::AVX2);
+		if(cpu.avx512) {
+			res.push_back(SIMDType::AVX512);
+			res.push_back(SIMDType::AVX512FMA);
+		}
+
+		return res;
+	}
+
+	// Time stamp counter ticks, which match core cycles at the nominal frequency.
+	unsigned long long readCycles() {
+		#if defined(SIMD_CAPABLE)
+			return __rdtsc();
+		#else
+			return 0;
+		#endif
+	}
+
+	void printScientific(const float number, std::ostream& s) {
+		std::ios streamState(nullptr);
+		streamState.copyfmt(s);
+		s << std::scientific << std::setprecision(1) << number;
+		s.copyfmt(streamState);
+	}
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		// The vectors of one run fit in L2, so the kernels are measured rather than memory.
+		constexpr size_t floatsPerRun = 16384;
+		constexpr size_t floatsPerRow = size_t(1) << 26;
+		const std::vector<size_t> dims{
+			4, 16, 25, 32, 64, 96, 100, 128, 200, 256, 384, 512, 768, 960, 1024, 1536
+		};
+		const auto simdTypes = getAvailableSIMD();
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+
+		printField("Dim", std::cout, 6);
+		printField("Space", std::cout, 15);
+		printField("SIMD", std::cout, 11);
+		printField("Function", std::cout, 18);
+		printField("Batch ns", std::cout, 10);
+		printField("Batch cycles", std::cout, 14);
+		printField("Single ns", std::cout, 11);
+		printField("Max rel. error", std::cout, 16);
+		printField("\n", std::cout, 1);
+
+		for(const auto dim : dims) {
+			const auto count = std::max(floatsPerRun / dim, size_t(64));
+			const auto reps = std::max(floatsPerRow / (dim * count), size_t(1));
+			std::vector<uint> ids(count);
+			std::vector<float> query(dim);
+			std::vector<float> train(dim * count);
+
+			std::iota(ids.begin(), ids.end(), 0);
+
+			for(auto& f : query)
+				f = dist(gen);
+			for(auto& f : train)
+				f = dist(gen);
+
+			for(const auto kind : {SpaceKind::EUCLIDEAN, SpaceKind::INNER_PRODUCT}) {
+				std::vector<float> expected;
+
+				for(const auto simdType : simdTypes) {
+					Space space(dim, kind, uint(count), simdType);
+					std::vector<float> res(count);
+
+					for(size_t i = 0; i < count; i++)
+						space.push(Element(train.data() + i * dim, uint(i)));
+
+					const auto cyclesStart = readCycles();
+					Timer timer{};
+
+					for(size_t r = 0; r < reps; r++)
+						space.getDistances(query.data(), ids.data(), count, res.data(), 0);
+
+					const auto batchElapsed = chr::duration<float>(timer.getElapsed()).count();
+					const auto batchCycles = readCycles() - cyclesStart;
+
+					timer.reset();
+
+					for(size_t r = 0; r < reps; r++)
+						for(size_t i = 0; i < count; i++)
+							res[i] = space.getDistance(query.data(), uint(i));
+
+					const auto singleElapsed = chr::duration<float>(timer.getElapsed()).count();
+
+					if(expected.empty())
+						expected = res;
+
+					auto maxError = 0.f;
+
+					for(size_t i = 0; i < count; i++)
+						maxError = std::max(
+							maxError,
+							std::abs(res[i] - expected[i]) / std::max(std::abs(expected[i]), 1e-6f)
+						);
+
+					const auto nsPerDistance = 1e9f / float(reps * count);
+
+					printField(dim, std::cout, 6);
+					printField(spaceKindToStr(kind), std::cout, 15);
+					printField(SIMDTypeToStr(simdType), std::cout, 11);
+					printField(space.getDistanceName(), std::cout, 18);
+					std::cout << std::right << std::setw(10);
+					print(batchElapsed * nsPerDistance, std::cout);
+					std::cout << std::right << std::setw(14);
+					print(float(batchCycles) / float(reps * count), std::cout, 1);
+					std::cout << std::right << std::setw(11);
+					print(singleElapsed * nsPerDistance, std::cout);
+					std::cout << std::right << std::setw(16);
+					printScientific(maxError, std::cout);
+					printField("\n", std::cout, 1);
+				}
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
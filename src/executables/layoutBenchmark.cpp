@@ -0,0 +1,64 @@
+#include <cstdlib>
+#include <iostream>
+#include "chm/Benchmark.hpp"
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t trainCount = 1000000;
+		const auto dataset = std::make_shared<Dataset>(
+			128, 10, 104, SpaceKind::EUCLIDEAN, SIMDType::BEST, 1000, trainCount
+		);
+		const auto workers = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+		std::cout << dataset->getString() << '\n';
+
+		for(const auto layout : {StorageLayout::SPLIT, StorageLayout::INTERLEAVED}) {
+			const auto index = std::make_shared<ParallelIndex>(
+				IndexConfig(100, 16, uint(trainCount), layout), dataset->dim, 200,
+				dataset->spaceKind, dataset->simdType
+			);
+			index->setWorkersNum(workers);
+
+			Timer timer{};
+			dataset->build(index);
+			const auto buildElapsed = timer.getElapsed();
+			index->setWorkersNum(1);
+
+			std::cout << index->getString() << "\nBuild: ";
+			prettyPrint(buildElapsed, std::cout);
+			std::cout << '\n';
+			printField("Prefetch", std::cout, 8);
+			printField("EfSearch", std::cout, 9);
+			printField("Recall", std::cout, 8);
+			printField("Queries per second", std::cout, 20);
+			printField("\n", std::cout, 1);
+
+			for(const uint prefetchDistance : {0, 1, 2, 4}) {
+				index->setPrefetchDistance(prefetchDistance);
+
+				for(const uint efSearch : {10, 40, 100, 200}) {
+					timer.reset();
+					const auto res = dataset->query(index, efSearch);
+					const auto elapsed = chr::duration<float>(timer.getElapsed()).count();
+
+					printField(prefetchDistance, std::cout, 8);
+					printField(efSearch, std::cout, 9);
+					std::cout << std::right << std::setw(8);
+					print(dataset->getRecall(res->getIDs()), std::cout, 3);
+					std::cout << std::right << std::setw(20);
+					print(float(dataset->testCount) / elapsed, std::cout);
+					printField("\n", std::cout, 1);
+				}
+			}
+
+			std::cout << '\n';
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	struct MemoryUsage {
+		float anonMiB;
+		float fileMiB;
+	};
+
+	// Resident memory split into private pages and shareable file pages, zero where /proc is missing.
+	MemoryUsage getMemoryUsage() {
+		MemoryUsage res{0.f, 0.f};
+		std::ifstream status("/proc/self/status");
+		std::string line;
+
+		while(std::getline(status, line)) {
+			std::istringstream s(line);
+			std::string key;
+			size_t kiB = 0;
+			s >> key >> kiB;
+
+			if(key == "RssAnon:")
+				res.anonMiB = float(kiB) / 1024.f;
+			else if(key == "RssFile:")
+				res.fileMiB = float(kiB) / 1024.f;
+		}
+
+		return res;
+	}
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 32;
+		constexpr uint efSearch = 50;
+		constexpr uint k = 10;
+		constexpr size_t queryCount = 2000;
+		constexpr size_t trainCount = 100000;
+		const std::string path = "loadBenchmark.bin";
+		const auto workers = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		std::vector<uint> expectedIDs;
+
+		{
+			const IndexConfig cfg(200, 16, uint(trainCount));
+			ParallelIndex index(cfg, dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+			index.setWorkersNum(workers);
+			index.push(ArrayView<const float>(train.data(), dim, trainCount));
+			index.queryBatch(testView, efSearch, k)->copyIDsTo(expectedIDs);
+			index.save(path);
+		}
+
+		// The page cache is warm after saving, so this compares copying with mapping, not disk reads.
+		printField("Mode", std::cout, 6);
+		printField("Load seconds", std::cout, 14);
+		printField("First batch seconds", std::cout, 21);
+		printField("Anon MiB", std::cout, 10);
+		printField("File MiB", std::cout, 10);
+		printField("Same results", std::cout, 14);
+		printField("\n", std::cout, 1);
+
+		for(const auto mode : {LoadMode::COPY, LoadMode::MAP}) {
+			const auto before = getMemoryUsage();
+
+			Timer timer{};
+			ParallelIndex index(std::make_shared<IndexFile>(path, mode), 200, SIMDType::BEST);
+			const auto loadElapsed = chr::duration<float>(timer.getElapsed()).count();
+			index.setWorkersNum(workers);
+
+			timer.reset();
+			std::vector<uint> foundIDs;
+			index.queryBatch(testView, efSearch, k)->copyIDsTo(foundIDs);
+			const auto queryElapsed = chr::duration<float>(timer.getElapsed()).count();
+			const auto after = getMemoryUsage();
+
+			printField(loadModeToStr(mode), std::cout, 6);
+			std::cout << std::right << std::setw(14);
+			print(loadElapsed, std::cout, 4);
+			std::cout << std::right << std::setw(21);
+			print(queryElapsed, std::cout, 4);
+			std::cout << std::right << std::setw(10);
+			print(after.anonMiB - before.anonMiB, std::cout);
+			std::cout << std::right << std::setw(10);
+			print(after.fileMiB - before.fileMiB, std::cout);
+			printField(foundIDs == expectedIDs ? "yes" : "no", std::cout, 14);
+			printField("\n", std::cout, 1);
+		}
+
+		std::remove(path.c_str());
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	// Batches mix cheap lookups with expensive ones, as a router serving both would.
+	struct QueryClass {
+		chm::uint efSearch;
+		chm::uint k;
+	};
+
+	void appendDense(
+		chm::QueryResults& res, const std::vector<size_t>& queryIdx,
+		const std::vector<chm::uint>& k, std::vector<std::vector<chm::Node>>& lists
+	) {
+		for(size_t i = 0; i < queryIdx.size(); i++)
+			for(size_t j = 0; j < k[queryIdx[i]]; j++)
+				lists[queryIdx[i]].emplace_back(res.getDistance(i, j), res.getID(i, j));
+	}
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t batch = 64;
+		constexpr size_t dim = 32;
+		constexpr size_t queryCount = 2048;
+		constexpr size_t trainCount = 20000;
+		constexpr QueryClass heavy{400, 200};
+		constexpr QueryClass light{20, 5};
+		std::bernoulli_distribution heavyDist(0.2);
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<uint> efSearch(queryCount);
+		std::vector<uint> k(queryCount);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		for(size_t i = 0; i < queryCount; i++) {
+			const auto& c = heavyDist(gen) ? heavy : light;
+			efSearch[i] = c.efSearch;
+			k[i] = c.k;
+		}
+
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+		BruteforceIndex bruteforce(dim, trainCount, SIMDType::BEST, SpaceKind::EUCLIDEAN);
+		bruteforce.push(trainView);
+		std::vector<size_t> allIdx(queryCount);
+		std::vector<std::vector<Node>> correctLists(queryCount);
+
+		for(size_t i = 0; i < queryCount; i++)
+			allIdx[i] = i;
+
+		appendDense(*bruteforce.queryBatch(testView, heavy.k), allIdx, k, correctLists);
+		const RaggedResults correct(correctLists);
+
+		ParallelIndex index(
+			IndexConfig(100, 16, uint(trainCount)), dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST
+		);
+		index.push(trainView);
+
+		printField("Workers", std::cout, 8);
+		printField("Mode", std::cout, 9);
+		printField("QPS", std::cout, 10);
+		printField("Recall", std::cout, 8);
+		printField("\n", std::cout, 1);
+
+		for(const size_t workers : {1, 4}) {
+			index.setWorkersNum(workers);
+
+			for(const std::string mode : {"uniform", "split", "ragged"}) {
+				std::vector<std::vector<Node>> foundLists(queryCount);
+				Timer timer{};
+
+				for(size_t first = 0; first < queryCount; first += batch) {
+					const ArrayView<const float> batchView(test.data() + first * dim, dim, batch);
+
+					if(mode == "uniform") {
+						std::vector<size_t> batchIdx(batch);
+
+						for(size_t i = 0; i < batch; i++)
+							batchIdx[i] = first + i;
+
+						const auto res = index.queryBatch(batchView, heavy.efSearch, heavy.k);
+						appendDense(*res, batchIdx, k, foundLists);
+
+					} else if(mode == "split") {
+						for(const auto& c : {heavy, light}) {
+							std::vector<size_t> batchIdx;
+							std::vector<float> batchData;
+
+							for(size_t i = first; i < first + batch; i++)
+								if(k[i] == c.k) {
+									batchIdx.push_back(i);
+									const auto q = test.begin() + i * dim;
+									batchData.insert(batchData.end(), q, q + dim);
+								}
+
+							if(batchIdx.empty())
+								continue;
+
+							const auto res = index.queryBatch(
+								ArrayView<const float>(batchData.data(), dim, batchIdx.size()),
+								c.efSearch, c.k
+							);
+							appendDense(*res, batchIdx, k, foundLists);
+						}
+
+					} else {
+						const std::vector<uint> batchEf(
+							efSearch.begin() + first, efSearch.begin() + first + batch
+						);
+						const std::vector<uint> batchK(k.begin() + first, k.begin() + first + batch);
+						const auto res = index.queryBatch(batchView, batchEf, batchK);
+
+						for(size_t i = 0; i < batch; i++)
+							for(size_t j = 0; j < res->getCount(i); j++)
+								foundLists[first + i].emplace_back(
+									res->getDistance(i, j), res->getID(i, j)
+								);
+					}
+				}
+
+				const auto elapsed = chr::duration<float>(timer.getElapsed()).count();
+
+				printField(workers, std::cout, 8);
+				printField(mode, std::cout, 9);
+				std::cout << std::right << std::setw(10);
+				print(float(queryCount) / elapsed, std::cout, 1);
+				std::cout << std::right << std::setw(8);
+				print(getRaggedRecall(correct, RaggedResults(foundLists)), std::cout, 3);
+				printField("\n", std::cout, 1);
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr uint efSearch = 100;
+		constexpr uint k = 10;
+		constexpr size_t queryCount = 1000;
+		constexpr size_t trainCount = 20000;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+
+		printField("Dim", std::cout, 5);
+		printField("Padded", std::cout, 8);
+		printField("Function", std::cout, 18);
+		printField("Vector MiB", std::cout, 12);
+		printField("Build seconds", std::cout, 15);
+		printField("QPS", std::cout, 10);
+		printField("Recall", std::cout, 8);
+		printField("\n", std::cout, 1);
+
+		for(const size_t dim : {25, 100, 300}) {
+			std::vector<float> test(dim * queryCount);
+			std::vector<float> train(dim * trainCount);
+
+			for(auto& f : train)
+				f = dist(gen);
+			for(auto& f : test)
+				f = dist(gen);
+
+			const ArrayView<const float> testView(test.data(), dim, queryCount);
+			const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+			BruteforceIndex bruteforce(dim, trainCount, SIMDType::BEST, SpaceKind::EUCLIDEAN);
+			bruteforce.push(trainView);
+			const auto correct = bruteforce.queryBatch(testView, k);
+
+			for(const auto padded : {false, true}) {
+				const IndexConfig cfg(
+					100, 16, uint(trainCount), StorageLayout::SPLIT, 0.0, VectorStorage::FLOAT, false, 0,
+					padded
+				);
+				SequentialIndex index(cfg, dim, 100, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+
+				Timer timer{};
+				index.push(trainView);
+				const auto buildElapsed = chr::duration<float>(timer.getElapsed()).count();
+
+				timer.reset();
+				const auto found = index.queryBatch(testView, efSearch, k);
+				const auto queryElapsed = chr::duration<float>(timer.getElapsed()).count();
+				const auto vectorBytes = index.space.getVectorBytes() * trainCount;
+
+				printField(dim, std::cout, 5);
+				printField(padded ? "yes" : "no", std::cout, 8);
+				printField(index.space.getDistanceName(), std::cout, 18);
+				std::cout << std::right << std::setw(12);
+				print(float(vectorBytes) / (1024.f * 1024.f), std::cout);
+				std::cout << std::right << std::setw(15);
+				print(buildElapsed, std::cout);
+				std::cout << std::right << std::setw(10);
+				print(float(queryCount) / queryElapsed, std::cout, 1);
+				std::cout << std::right << std::setw(8);
+				print(getRecall(correct->getIDs(), found->getIDs()), std::cout, 3);
+				printField("\n", std::cout, 1);
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
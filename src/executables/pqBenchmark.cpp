@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	struct StorageMode {
+		bool rerank;
+		chm::VectorStorage storage;
+		chm::uint subspaces;
+	};
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 64;
+		constexpr uint efSearch = 100;
+		constexpr uint k = 10;
+		constexpr size_t queryCount = 1000;
+		constexpr size_t trainCount = 50000;
+		const std::vector<StorageMode> modes{
+			{false, VectorStorage::FLOAT, 0},
+			{false, VectorStorage::PQ, 8},
+			{false, VectorStorage::PQ, 16},
+			{false, VectorStorage::PQ, 32},
+			{true, VectorStorage::PQ, 8},
+			{true, VectorStorage::PQ, 16},
+			{true, VectorStorage::PQ, 32}
+		};
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+		BruteforceIndex bruteforce(dim, trainCount, SIMDType::BEST, SpaceKind::EUCLIDEAN);
+		bruteforce.push(trainView);
+		const auto correct = bruteforce.queryBatch(testView, k);
+
+		// Reranked rows also count the float vectors, which can stay in a mapped index file.
+		printField("Storage", std::cout, 8);
+		printField("Code bytes", std::cout, 12);
+		printField("Rerank", std::cout, 8);
+		printField("Vector MiB", std::cout, 12);
+		printField("QPS", std::cout, 10);
+		printField("Recall@10", std::cout, 11);
+		printField("\n", std::cout, 1);
+
+		for(const auto& mode : modes) {
+			const IndexConfig cfg(
+				200, 16, uint(trainCount), StorageLayout::SPLIT, 0.0, mode.storage, mode.rerank,
+				mode.subspaces
+			);
+			SequentialIndex index(cfg, dim, 100, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+			index.push(trainView);
+			const auto vectorBytes = index.space.getAllocatedBytes();
+
+			Timer timer{};
+			const auto found = index.queryBatch(testView, efSearch, k);
+			const auto elapsed = chr::duration<float>(timer.getElapsed()).count();
+
+			const auto codeBytes = mode.storage == VectorStorage::FLOAT
+				? dim * sizeof(float)
+				: size_t(mode.subspaces);
+
+			printField(vectorStorageToStr(mode.storage), std::cout, 8);
+			printField(codeBytes, std::cout, 12);
+			printField(mode.rerank ? "yes" : "no", std::cout, 8);
+			std::cout << std::right << std::setw(12);
+			print(float(vectorBytes) / (1024.f * 1024.f), std::cout);
+			std::cout << std::right << std::setw(10);
+			print(float(queryCount) / elapsed, std::cout, 1);
+			std::cout << std::right << std::setw(11);
+			print(getRecall(correct->getIDs(), found->getIDs()), std::cout, 3);
+			printField("\n", std::cout, 1);
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
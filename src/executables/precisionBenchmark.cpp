@@ -0,0 +1,86 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	struct Run {
+		chm::SpaceKind kind;
+		chm::VectorStorage storage;
+	};
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 128;
+		constexpr uint k = 10;
+		constexpr size_t queryCount = 1000;
+		constexpr size_t trainCount = 50000;
+		const std::vector<uint> efSearchValues{10, 20, 40, 80, 160};
+		const std::vector<Run> runs{
+			{SpaceKind::EUCLIDEAN, VectorStorage::FLOAT},
+			{SpaceKind::EUCLIDEAN, VectorStorage::FP16},
+			{SpaceKind::EUCLIDEAN, VectorStorage::BF16},
+			{SpaceKind::INNER_PRODUCT, VectorStorage::FLOAT},
+			{SpaceKind::INNER_PRODUCT, VectorStorage::FP16},
+			{SpaceKind::INNER_PRODUCT, VectorStorage::BF16}
+		};
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+		printField("Space", std::cout, 15);
+		printField("Storage", std::cout, 9);
+		printField("Vector MiB", std::cout, 12);
+		printField("EfSearch", std::cout, 10);
+		printField("QPS", std::cout, 10);
+		printField("Recall", std::cout, 8);
+		printField("\n", std::cout, 1);
+
+		for(const auto& run : runs) {
+			BruteforceIndex bruteforce(dim, trainCount, SIMDType::BEST, run.kind);
+			bruteforce.push(trainView);
+			const auto correct = bruteforce.queryBatch(testView, k);
+
+			const IndexConfig cfg(200, 16, uint(trainCount), StorageLayout::SPLIT, 0.0, run.storage);
+			SequentialIndex index(cfg, dim, 100, run.kind, SIMDType::BEST);
+			index.push(trainView);
+			const auto vectorBytes = index.space.getAllocatedBytes();
+			const auto vectorMiB = float(vectorBytes) / (1024.f * 1024.f);
+
+			for(const auto efSearch : efSearchValues) {
+				Timer timer{};
+				const auto found = index.queryBatch(testView, efSearch, k);
+				const auto elapsed = chr::duration<float>(timer.getElapsed()).count();
+
+				printField(spaceKindToStr(run.kind), std::cout, 15);
+				printField(vectorStorageToStr(run.storage), std::cout, 9);
+				std::cout << std::right << std::setw(12);
+				print(vectorMiB, std::cout);
+				printField(efSearch, std::cout, 10);
+				std::cout << std::right << std::setw(10);
+				print(float(queryCount) / elapsed, std::cout, 1);
+				std::cout << std::right << std::setw(8);
+				print(getRecall(correct->getIDs(), found->getIDs()), std::cout, 3);
+				printField("\n", std::cout, 1);
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	struct StorageMode {
+		const char* name;
+		bool rerank;
+		chm::VectorStorage storage;
+	};
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 64;
+		constexpr uint k = 10;
+		constexpr size_t queryCount = 1000;
+		constexpr size_t trainCount = 50000;
+		const std::vector<uint> efSearchValues{10, 20, 40, 80, 160};
+		const std::vector<StorageMode> modes{
+			{"float", false, VectorStorage::FLOAT},
+			{"int8", false, VectorStorage::INT8},
+			{"int8 rerank", true, VectorStorage::INT8}
+		};
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+		BruteforceIndex bruteforce(dim, trainCount, SIMDType::BEST, SpaceKind::EUCLIDEAN);
+		bruteforce.push(trainView);
+		const auto correct = bruteforce.queryBatch(testView, k);
+
+		printField("Storage", std::cout, 12);
+		printField("Vector MiB", std::cout, 12);
+		printField("EfSearch", std::cout, 10);
+		printField("QPS", std::cout, 10);
+		printField("Recall", std::cout, 8);
+		printField("\n", std::cout, 1);
+
+		for(const auto& mode : modes) {
+			const IndexConfig cfg(
+				200, 16, uint(trainCount), StorageLayout::SPLIT, 0.0, mode.storage, mode.rerank
+			);
+			SequentialIndex index(cfg, dim, 100, SpaceKind::EUCLIDEAN, SIMDType::BEST);
+			index.push(trainView);
+			const auto vectorBytes = index.space.getVectorBytes() * trainCount;
+			const auto vectorMiB = float(vectorBytes) / (1024.f * 1024.f);
+
+			for(const auto efSearch : efSearchValues) {
+				Timer timer{};
+				const auto found = index.queryBatch(testView, efSearch, k);
+				const auto elapsed = chr::duration<float>(timer.getElapsed()).count();
+
+				printField(mode.name, std::cout, 12);
+				std::cout << std::right << std::setw(12);
+				print(vectorMiB, std::cout);
+				printField(efSearch, std::cout, 10);
+				std::cout << std::right << std::setw(10);
+				print(float(queryCount) / elapsed, std::cout, 1);
+				std::cout << std::right << std::setw(8);
+				print(getRecall(correct->getIDs(), found->getIDs()), std::cout, 3);
+				printField("\n", std::cout, 1);
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
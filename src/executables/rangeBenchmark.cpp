@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "chm/Benchmark.hpp"
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 25;
+		constexpr size_t queryCount = 1000;
+		constexpr size_t trainCount = 50000;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> test(dim * queryCount);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+		for(auto& f : test)
+			f = dist(gen);
+
+		const ArrayView<const float> testView(test.data(), dim, queryCount);
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+
+		BruteforceIndex bruteforce(dim, trainCount, SIMDType::BEST, SpaceKind::EUCLIDEAN);
+		bruteforce.push(trainView);
+
+		SequentialIndex index(
+			IndexConfig(200, 16, uint(trainCount)), dim, 100, SpaceKind::EUCLIDEAN, SIMDType::BEST
+		);
+		index.push(trainView);
+
+		printField("Target", std::cout, 8);
+		printField("Radius", std::cout, 8);
+		printField("Avg. found", std::cout, 12);
+		printField("EfSearch", std::cout, 10);
+		printField("QPS", std::cout, 10);
+		printField("Recall", std::cout, 8);
+		printField("\n", std::cout, 1);
+
+		for(const size_t target : {10, 100, 1000}) {
+			// The median distance to the target-th neighbor gives about target results per query.
+			const auto knn = bruteforce.queryBatch(testView, target);
+			std::vector<float> targetDistances(queryCount);
+
+			for(size_t i = 0; i < queryCount; i++)
+				targetDistances[i] = knn->getDistance(i, target - 1);
+
+			std::nth_element(
+				targetDistances.begin(), targetDistances.begin() + queryCount / 2,
+				targetDistances.end()
+			);
+			const auto radius = targetDistances[queryCount / 2];
+
+			Timer timer{};
+			const auto correct = bruteforce.rangeQueryBatch(testView, radius);
+			const auto bruteforceElapsed = chr::duration<float>(timer.getElapsed()).count();
+
+			const auto printRow = [&](
+				const RaggedResults& found, const std::string& ef, const float elapsed
+			) {
+				printField(target, std::cout, 8);
+				std::cout << std::right << std::setw(8);
+				print(radius, std::cout);
+				std::cout << std::right << std::setw(12);
+				print(float(found.getTotalCount()) / float(queryCount), std::cout, 1);
+				printField(ef, std::cout, 10);
+				std::cout << std::right << std::setw(10);
+				print(float(queryCount) / elapsed, std::cout, 1);
+				std::cout << std::right << std::setw(8);
+				print(getRaggedRecall(*correct, found), std::cout, 3);
+				printField("\n", std::cout, 1);
+			};
+
+			printRow(*correct, "exact", bruteforceElapsed);
+
+			for(const uint efSearch : {10, 50, 100}) {
+				timer.reset();
+				const auto found = index.rangeQueryBatch(testView, radius, efSearch);
+				printRow(
+					*found, std::to_string(efSearch), chr::duration<float>(timer.getElapsed()).count()
+				);
+			}
+		}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <iostream>
+#include "chm/Benchmark.hpp"
+
+namespace {
+	struct SyncConfig {
+		chm::LockMode lockMode;
+		bool optimisticReads;
+		size_t stripeCount;
+	};
+}
+
+int main() {
+	using namespace chm;
+
+	try {
+		constexpr size_t dim = 32;
+		constexpr size_t trainCount = 20000;
+		std::uniform_real_distribution<float> dist{};
+		std::default_random_engine gen(104);
+		std::vector<float> train(dim * trainCount);
+
+		for(auto& f : train)
+			f = dist(gen);
+
+		const IndexConfig cfg(200, 16, uint(trainCount));
+		const ArrayView<const float> trainView(train.data(), dim, trainCount);
+		const SyncConfig syncConfigs[] = {
+			{LockMode::MUTEX, false, 0},
+			{LockMode::MUTEX, true, 0},
+			{LockMode::SPIN, false, 0},
+			{LockMode::SPIN, true, 0},
+			{LockMode::STRIPED, false, 1024},
+			{LockMode::STRIPED, true, 1024}
+		};
+
+		printField("Locks", std::cout, 9);
+		printField("Stripes", std::cout, 8);
+		printField("Reads", std::cout, 12);
+		printField("Lock bytes per node", std::cout, 21);
+		printField("Workers", std::cout, 8);
+		printField("Build elapsed", std::cout, 22);
+		printField("Elements per second", std::cout, 22);
+		printField("\n", std::cout, 1);
+
+		for(const auto& c : syncConfigs)
+			for(const size_t workers : {1, 2, 4, 8, 16, 32, 64}) {
+				ParallelIndex index(
+					cfg, dim, 200, SpaceKind::EUCLIDEAN, SIMDType::BEST, c.lockMode, c.stripeCount
+				);
+				index.setOptimisticReads(c.optimisticReads);
+				index.setWorkersNum(workers);
+
+				Timer timer{};
+				index.push(trainView);
+				const auto elapsed = timer.getElapsed();
+
+				printField(lockModeToStr(c.lockMode), std::cout, 9);
+				printField(c.stripeCount, std::cout, 8);
+				printField(c.optimisticReads ? "optimistic" : "locked", std::cout, 12);
+				std::cout << std::right << std::setw(21);
+				print(float(index.getLockBytes()) / float(trainCount), std::cout);
+				printField(workers, std::cout, 8);
+				std::cout << std::right << std::setw(22);
+				prettyPrint(elapsed, std::cout);
+				std::cout << std::right << std::setw(22);
+				print(float(trainCount) / chr::duration<float>(elapsed).count(), std::cout);
+				printField("\n", std::cout, 1);
+			}
+
+	} catch(const std::exception& e) {
+		std::cerr << "[ERROR] " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
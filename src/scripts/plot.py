@@ -221,8 +221,10 @@ class Stats:
 def getAvailableSIMD():
 	best = h.getBestSIMDType()
 
-	if best == h.SIMDType.AVX512:
-		return [h.SIMDType.AVX512, h.SIMDType.AVX, h.SIMDType.SSE,]
+	if best == h.SIMDType.AVX512FMA:
+		return [h.SIMDType.AVX512FMA, h.SIMDType.AVX512, h.SIMDType.AVX2, h.SIMDType.AVX, h.SIMDType.SSE]
+	if best == h.SIMDType.AVX2:
+		return [h.SIMDType.AVX2, h.SIMDType.AVX, h.SIMDType.SSE]
 	if best == h.SIMDType.AVX:
 		return [h.SIMDType.AVX, h.SIMDType.SSE]
 	if best == h.SIMDType.SSE:
@@ -1,6 +1,4 @@
 from glob import glob
-from pathlib import Path
-import platform
 import pybind11
 import setuptools
 from setuptools import Extension, setup
@@ -8,9 +6,6 @@ from setuptools.command.build_ext import build_ext
 import sys
 import tempfile
 
-sys.path.append(str(Path(__file__).parent.absolute()))
-from scripts.SIMDCapability import SIMDCapability
-
 MSVC_QUOTE = r'\\"'
 
 def addPreprocessorMacro(name: str, compilerType: str, opts: list[str], val: str = None):
@@ -29,18 +24,6 @@ def addPreprocessorMacro(name: str, compilerType: str, opts: list[str], val: str
 
 		opts.append(cmd)
 
-def addSIMDMacros(compilerType: str, opts: list[str]):
-	simd = SIMDCapability()
-
-	for macro in simd.getMacros():
-		addPreprocessorMacro(macro, compilerType, opts)
-
-	if compilerType == "msvc":
-		arch = simd.getMsvcArchFlag()
-
-		if arch is not None:
-			opts.append(arch)
-
 class BuildExt(build_ext):
 	"""A custom build extension for adding compiler-specific options."""
 	c_opts = {
@@ -52,11 +35,7 @@ class BuildExt(build_ext):
 		"unix": []
 	}
 
-	c_opts["unix"].append("-march=native")
-
 	if sys.platform == "darwin":
-		if platform.machine() == "arm64":
-			c_opts["unix"].remove("-march=native")
 		c_opts["unix"] += ["-stdlib=libc++", "-mmacosx-version-min=10.7"]
 		link_opts["unix"] += ["-stdlib=libc++", "-mmacosx-version-min=10.7"]
 
@@ -72,7 +51,6 @@ class BuildExt(build_ext):
 
 		opts.append(cppStandard)
 		addPreprocessorMacro("VERSION_INFO", ct, opts, self.distribution.get_version())
-		addSIMDMacros(ct, opts)
 
 		for ext in self.extensions:
 			ext.extra_compile_args.extend(opts)